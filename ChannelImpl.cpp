@@ -33,7 +33,11 @@
  *	The Equalizer channel implementation: this class is the entry point for
  *	every rendering operation. It sets up the draw context and calls the
  *  omegalib Renderer.draw method to perform the actual rendering.
+ *  When frame export is enabled, the channel also reads back each frame
+ *  asynchronously through pixel buffer objects and passes it to the 
+ *  FrameExporter.
  ******************************************************************************/
+#include "omega/glheaders.h"
 #include "eqinternal.h"
 #include "omega/DisplaySystem.h"
 
@@ -51,7 +55,7 @@ using namespace eq;
 
 ///////////////////////////////////////////////////////////////////////////////
 ChannelImpl::ChannelImpl( eq::Window* parent ) 
-    :eq::Channel( parent ), myWindow((WindowImpl*)parent), myDrawBuffer(NULL)
+    :eq::Channel( parent ), myWindow((WindowImpl*)parent), myCurrentReadbackSlot(0)
 {
 }
 
@@ -69,7 +73,11 @@ bool ChannelImpl::configInit(const eq::uint128_t& initID)
 
     if(ds->getDisplayConfig().tiles.find(name) == ds->getDisplayConfig().tiles.end())
     {
-        oferror("ChannelImpl::configInit: could not find tile %1%", %name);
+        // Destination channels created by Equalizer for canvas views (hot 
+        // reconfiguration mode) may not carry the tile name: use the tile
+        // of the parent window.
+        myDC.tile = myWindow->getTileConfig();
+        if(myDC.tile == NULL) oferror("ChannelImpl::configInit: could not find tile %1%", %name);
     }
     else
     {
@@ -80,12 +88,120 @@ bool ChannelImpl::configInit(const eq::uint128_t& initID)
     myDC.gpuContext = client->getGpuContext();
     myDC.renderer = client;
 
+    if(ds->isFrameExportEnabled()) initializeReadback();
+
     return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+bool ChannelImpl::configExit()
+{
+    disposeReadback();
+    return eq::Channel::configExit();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ChannelImpl::initializeReadback()
+{
+    EqualizerDisplaySystem* ds = (EqualizerDisplaySystem*)SystemManager::instance()->getDisplaySystem();
+    myReadbackSlots.resize(ds->getFrameExportBuffers());
+    for(int i = 0; i < myReadbackSlots.size(); i++)
+    {
+        ReadbackSlot& slot = myReadbackSlots[i];
+        GLuint pbo;
+        glGenBuffers(1, &pbo);
+        slot.pbo = pbo;
+        slot.frameNum = 0;
+        slot.width = 0;
+        slot.height = 0;
+        slot.pending = false;
+    }
+    myCurrentReadbackSlot = 0;
+    oflog(Verbose, "[ChannelImpl::initializeReadback] <%1%> %2% readback buffers", 
+        %getName() %myReadbackSlots.size());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ChannelImpl::disposeReadback()
+{
+    for(int i = 0; i < myReadbackSlots.size(); i++)
+    {
+        GLuint pbo = myReadbackSlots[i].pbo;
+        glDeleteBuffers(1, &pbo);
+    }
+    myReadbackSlots.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ChannelImpl::readbackFrame(uint64 frameNum)
+{
+    EqualizerDisplaySystem* ds = (EqualizerDisplaySystem*)SystemManager::instance()->getDisplaySystem();
+    FrameExporter* exporter = ds->getFrameExporter();
+
+    // Nobody is listening: don't waste bandwidth on the readback. Pending 
+    // slots are simply dropped.
+    if(!exporter->hasListeners())
+    {
+        for(int i = 0; i < myReadbackSlots.size(); i++) myReadbackSlots[i].pending = false;
+        return;
+    }
+
+    const eq::PixelViewport& pvp = getPixelViewport();
+    int numSlots = myReadbackSlots.size();
+
+    // Queue the readback of the frame we just drew. glReadPixels into a bound 
+    // pack buffer returns immediately: the transfer happens in the background.
+    ReadbackSlot& cur = myReadbackSlots[myCurrentReadbackSlot];
+    size_t size = pvp.w * pvp.h * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, cur.pbo);
+    if(cur.width != pvp.w || cur.height != pvp.h)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        cur.width = pvp.w;
+        cur.height = pvp.h;
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(pvp.x, pvp.y, pvp.w, pvp.h, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    cur.frameNum = frameNum;
+    cur.pending = true;
+
+    // The oldest slot was queued numSlots - 1 frames ago, so its transfer is
+    // most likely complete and mapping it will not stall the pipeline.
+    myCurrentReadbackSlot = (myCurrentReadbackSlot + 1) % numSlots;
+    ReadbackSlot& old = myReadbackSlots[myCurrentReadbackSlot];
+    if(old.pending)
+    {
+        old.pending = false;
+        ExportedFrame* frame = exporter->acquireFrame();
+        if(frame != NULL)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, old.pbo);
+            void* pixels = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+            if(pixels != NULL && old.width > 0 && old.height > 0)
+            {
+                frame->channelName = getName();
+                frame->frameNum = old.frameNum;
+                frame->width = old.width;
+                frame->height = old.height;
+                frame->pixels.resize(old.width * old.height * 4);
+                memcpy(&frame->pixels[0], pixels, frame->pixels.size());
+                exporter->submitFrame(frame);
+            }
+            else
+            {
+                exporter->releaseFrame(frame);
+            }
+            if(pixels != NULL) glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void ChannelImpl::frameDraw( const co::base::uint128_t& frameID )
 {
+    uint64_t drawStart = FrameClock::now();
+
     // Pass the current tile to the draw context. The tile contains all the 
     // properties of the current draw surface.
     myDC.tile = myWindow->getTileConfig();
@@ -97,11 +213,21 @@ void ChannelImpl::frameDraw( const co::base::uint128_t& frameID )
         // (spin is 128 bits, gets truncated to 64... 
         // do we really need 128 bits anyways!?)
         myDC.drawFrame(frameID.low());
+
+        if(!myReadbackSlots.empty()) readbackFrame(frameID.low());
+
+        uint64_t latency = myWindow->getInputLatency();
+        if(latency != SharedData::NoInput)
+        {
+            static_cast<ConfigImpl*>(getConfig())->getDrawLatency()->addSample(latency);
+        }
     }
     
     // NOTE: This call NEEDS to stay after drawFrames, or frames will not 
     // update / display correctly.
     eq::Channel::frameDraw( frameID );
+
+    myWindow->channelDrawn(drawStart, FrameClock::now());
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -61,12 +61,11 @@ Ray sPointerRay;
     if(key == keycode && type == Event::Down) sKeyFlags |= Event::flag; \
     if(key == keycode && type == Event::Up) keyFlagsToRemove |= Event::flag;
 
+// The expand functions turn input records queued by ConfigImpl::handleEvent
+// into omegalib events. They are called by startFrame with the event lock held.
 ///////////////////////////////////////////////////////////////////////////////
-void keyboardButtonCallback(uint key, Event::Type type)
+void expandKeyboardButton(ServiceManager* sm, uint key, Event::Type type)
 {
-    ServiceManager* sm = SystemManager::instance()->getServiceManager();
-    sm->lockEvents();
-
     Event* evt = sm->writeHead();
     evt->reset(type, Service::Keyboard, key);
 
@@ -105,32 +104,22 @@ void keyboardButtonCallback(uint key, Event::Type type)
 
     // Remove the bit of all buttons that have been unpressed.
     sKeyFlags &= ~keyFlagsToRemove;
-
-    sm->unlockEvents();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void mouseWheelCallback(int btn, int wheel, int x, int y)
+void expandPointerWheel(ServiceManager* sm, int wheel, int x, int y)
 {
-    ServiceManager* sm = SystemManager::instance()->getServiceManager();
-    sm->lockEvents();
     Event* evt = sm->writeHead();
     evt->reset(Event::Zoom, Service::Pointer);
     evt->setPosition(x, y);
 
     evt->setExtraDataType(Event::ExtraDataIntArray);
     evt->setExtraDataInt(0, wheel);
-
-    sm->unlockEvents();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void mouseMotionCallback(int x, int y)
+void expandPointerMotion(ServiceManager* sm, int x, int y)
 {
-    ServiceManager* sm = SystemManager::instance()->getServiceManager();
-
-    sm->lockEvents();
-
     Event* evt = sm->writeHead();
     evt->reset(Event::Move, Service::Pointer);
     evt->setPosition(x, y);
@@ -142,17 +131,11 @@ void mouseMotionCallback(int x, int y)
     evt->setExtraDataType(Event::ExtraDataVector3Array);
     evt->setExtraDataVector3(0, sPointerRay.getOrigin());
     evt->setExtraDataVector3(1, sPointerRay.getDirection());
-
-    sm->unlockEvents();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void mouseButtonCallback(int button, int state, int x, int y)
+void expandPointerButton(ServiceManager* sm, int button, int state, int x, int y)
 {
-    ServiceManager* sm = SystemManager::instance()->getServiceManager();
-
-    sm->lockEvents();
-
     Event* evt = sm->writeHead();
     evt->reset(state ? Event::Down : Event::Up, Service::Pointer);
     evt->setPosition(x, y);
@@ -174,17 +157,88 @@ void mouseButtonCallback(int button, int state, int x, int y)
     evt->setExtraDataType(Event::ExtraDataVector3Array);
     evt->setExtraDataVector3(0, sPointerRay.getOrigin());
     evt->setExtraDataVector3(1, sPointerRay.getDirection());
+}
 
-    sm->unlockEvents();
+///////////////////////////////////////////////////////////////////////////////
+void expandInputRecord(ServiceManager* sm, const InputRecord& r)
+{
+    switch(r.kind)
+    {
+    case InputRecord::KeyboardButton:
+        expandKeyboardButton(sm, r.code, (Event::Type)r.type);
+        break;
+    case InputRecord::PointerMotion:
+        expandPointerMotion(sm, r.x, r.y);
+        break;
+    case InputRecord::PointerButton:
+        expandPointerButton(sm, r.code, r.type, r.x, r.y);
+        break;
+    case InputRecord::PointerWheel:
+        expandPointerWheel(sm, r.wheel, r.x, r.y);
+        break;
+    }
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
 ConfigImpl::ConfigImpl( co::base::RefPtr< eq::Server > parent): 
-    eq::Config(parent) 
+    eq::Config(parent),
+    myLastBulkFrameTime(0),
+    myRelay(NULL),
+    myRecording(NULL),
+    myReplay(NULL),
+    myReplayFrame(0),
+    myReplayApplyTime(0),
+    myInputCapture(NULL),
+    myInputReplay(NULL),
+    myInputReplayFrame(0),
+    myDivergenceCheck(false),
+    myDrawLatency("input to draw"),
+    myDisplayLatency("input to display")
 {
     //omsg("[EQ] ConfigImpl::ConfigImpl");
     SharedDataServices::setSharedData(&mySharedData);
+    for(int i = 0; i < FrameHashHistory; i++) myFrameHashes[i].frameNum = (uint32_t)-1;
+
+    EqualizerDisplaySystem* eqds = (EqualizerDisplaySystem*)SystemManager::instance()->getDisplaySystem();
+    eqds->setConfig(this);
+    Setting* s = eqds->getDisplaySettings();
+    if(s != NULL) 
+    {
+        mySharedData.setup(*s);
+        if(Config::getBoolValue("sharedDataBulkLane", *s, false))
+        {
+            myBulkSharedData.setup(*s);
+            mySharedData.setBulkLane(&myBulkSharedData);
+        }
+        if(Config::getBoolValue("sharedDataInterest", *s, false))
+        {
+            createNodeLanes(*s);
+        }
+        SystemManager* sys = SystemManager::instance();
+        if(!sys->isMaster() && eqds->hasRelayChildren(sys->getHostnameAndPort()))
+        {
+            myRelay = new SharedDataRelay(&mySharedData);
+            mySharedData.setRelay(myRelay);
+        }
+        myFrameClock.setup(*s);
+        setupRecording(*s);
+        // Snapshots for rejoining nodes and recordings are built from the 
+        // object buffers of the last commit.
+        if(eqds->isHotReconfigurationEnabled() || myRecording != NULL)
+        {
+            mySharedData.setBuffered(true);
+            myBulkSharedData.setBuffered(true);
+        }
+        myDivergenceCheck = Config::getBoolValue("divergenceCheck", *s, false);
+        myDivergenceObjects = getStringList("divergenceObjects", *s);
+        mySharedData.setDivergenceCheckEnabled(myDivergenceCheck);
+        myDrawLatency.setup(*s);
+        myDisplayLatency.setup(*s);
+        myFrameTimings.setup(*s);
+        myPosePredictor.setup(*s);
+        myInputQueue.setup(*s);
+    }
 
 #ifdef OMEGA_OS_LINUX
     XInitThreads();
@@ -194,6 +248,34 @@ ConfigImpl::ConfigImpl( co::base::RefPtr< eq::Server > parent):
 ///////////////////////////////////////////////////////////////////////////////
 ConfigImpl::~ConfigImpl()
 {
+    // Closing the recording writes its frame index.
+    delete myRecording;
+    delete myReplay;
+    delete myInputCapture;
+    delete myInputReplay;
+
+    if(myRelay != NULL)
+    {
+        mySharedData.setRelay(NULL);
+        if(myRelay->isAttached()) deregisterObject(myRelay);
+        delete myRelay;
+    }
+
+    foreach(SharedData* lane, myNodeLanes)
+    {
+        if(lane->isAttached())
+        {
+            if(lane->isMaster()) deregisterObject(lane);
+            else unmapObject(lane);
+        }
+        delete lane;
+    }
+
+    if(myBulkSharedData.isAttached())
+    {
+        if(myBulkSharedData.isMaster()) deregisterObject(&myBulkSharedData);
+        else unmapObject(&myBulkSharedData);
+    }
     if(mySharedData.isAttached())
     {
         if(mySharedData.isMaster())
@@ -212,6 +294,10 @@ bool ConfigImpl::init()
 {
     olog(Verbose, "[EQ] ConfigImpl::init");
 
+    // The bulk lane is registered first: its id is sent with the priority
+    // lane snapshot.
+    if(isBulkLaneEnabled()) registerObject(&myBulkSharedData);
+    foreach(SharedData* lane, myNodeLanes) registerObject(lane);
     registerObject(&mySharedData);
     //mySharedData.setAutoObsolete(getLatency());
 
@@ -228,7 +314,7 @@ bool ConfigImpl::init()
     StatsManager* sm = SystemManager::instance()->getStatsManager();
     myFpsStat = sm->createStat("fps", StatsManager::Fps);
 
-    myGlobalTimer.start();
+    myFrameClock.reset();
 
     return eq::Config::init(mySharedData.getID());
 }
@@ -237,12 +323,142 @@ bool ConfigImpl::init()
 void ConfigImpl::mapSharedData(const uint128_t& initID)
 {
     //omsg("[EQ] ConfigImpl::mapSharedData");
+    SystemManager* sys = SystemManager::instance();
+    EqualizerDisplaySystem* eqds = (EqualizerDisplaySystem*)sys->getDisplaySystem();
+    String parentKey = eqds->getRelayParent(sys->getHostnameAndPort());
     if(!mySharedData.isAttached( ))
     {
-        if(!mapObject( &mySharedData, initID))
+        Timer timer;
+        timer.start();
+        if(parentKey != "")
+        {
+            if(!mapRelayParent(parentKey))
+            {
+                oferror("ConfigImpl::mapSharedData: mapping the relay of %1% failed", %parentKey);
+            }
+        }
+        else if(!mapObject( &mySharedData, initID))
         {
             oferror("ConfigImpl::mapSharedData: maoPobject failed (object id = %1%)", %initID);
         }
+        else
+        {
+            ofmsg("ConfigImpl::mapSharedData: received %1% bytes snapshot in %2% ms",
+                %mySharedData.getLastFrameSize() %timer.getElapsedTimeInMilliSec());
+        }
+    }
+
+    if(!myNodeLanes.empty() && !myNodeLanes.front()->isAttached())
+    {
+        const Dictionary<String, co::base::UUID>& ids = mySharedData.getNodeLaneIDs();
+        Dictionary<String, co::base::UUID>::const_iterator it = ids.find(myLocalNodeKey);
+        if(it == ids.end())
+        {
+            oferror("ConfigImpl::mapSharedData: no node lane for %1%", %myLocalNodeKey);
+        }
+        else if(!mapObject(myNodeLanes.front(), it->second))
+        {
+            oferror("ConfigImpl::mapSharedData: mapping the node lane failed (object id = %1%)", %it->second);
+        }
+    }
+
+    const co::base::UUID& bulkId = mySharedData.getBulkLaneID();
+    if(isBulkLaneEnabled() && !myBulkSharedData.isAttached() && bulkId != co::base::UUID::ZERO)
+    {
+        if(!mapObject(&myBulkSharedData, bulkId))
+        {
+            oferror("ConfigImpl::mapSharedData: mapping the bulk lane failed (object id = %1%)", %bulkId);
+        }
+    }
+
+    // Children of this node map the relay once it is registered.
+    if(myRelay != NULL && !myRelay->isAttached() && mySharedData.isAttached())
+    {
+        myRelay->setID(SharedDataRelay::getRelayID(sys->getHostnameAndPort()));
+        registerObject(myRelay);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool ConfigImpl::mapRelayParent(const String& parentKey)
+{
+    // Connect to the parent node: slaves listen on their node key (see
+    // EqualizerDisplaySystem::setupEqInitArgs).
+    size_t sep = parentKey.rfind(':');
+    co::ConnectionDescriptionPtr desc = new co::ConnectionDescription;
+    desc->type = co::CONNECTIONTYPE_TCPIP;
+    desc->setHostname(parentKey.substr(0, sep));
+    desc->port = atoi(parentKey.substr(sep + 1).c_str());
+    co::NodePtr parent = new co::Node;
+    parent->addConnectionDescription(desc);
+    if(!getClient()->connect(parent))
+    {
+        oferror("ConfigImpl::mapRelayParent: could not connect to %1%", %parentKey);
+        return false;
+    }
+
+    // The parent registers its relay once it has mapped the shared data 
+    // itself, and Collage has no way to wait for an object to be 
+    // registered: retry, backing off up to one attempt per second.
+    const double timeout = 30000;
+    int interval = 10;
+    bool waiting = false;
+    co::base::UUID relayId = SharedDataRelay::getRelayID(parentKey);
+    Timer timer;
+    timer.start();
+    while(timer.getElapsedTimeInMilliSec() < timeout)
+    {
+        if(mapObject(&mySharedData, relayId))
+        {
+            if(waiting)
+            {
+                ofmsg("ConfigImpl::mapRelayParent: relay of %1% mapped after %2% ms", 
+                    %parentKey %timer.getElapsedTimeInMilliSec());
+            }
+            return true;
+        }
+        if(!waiting)
+        {
+            ofmsg("ConfigImpl::mapRelayParent: waiting for the relay of %1%", %parentKey);
+            waiting = true;
+        }
+        osleep(interval);
+        interval = min(interval * 2, 1000);
+    }
+    oferror("ConfigImpl::mapRelayParent: the relay of %1% is not available after %2% s. This node, and the nodes relayed by it, receive no shared data", 
+        %parentKey %(timeout / 1000));
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ConfigImpl::unmapSharedData()
+{
+    // Unmapping stops this node from queuing shared data versions while it 
+    // is inactive. Nodes that are started again map it again, and receive
+    // the current state of all objects.
+    // The engine of this node is destroyed with it, so the objects it 
+    // registered are dropped as well.
+    if(mySharedData.isAttached() && !mySharedData.isMaster())
+    {
+        unmapObject(&mySharedData);
+        mySharedData.clearObjects();
+    }
+    if(myBulkSharedData.isAttached() && !myBulkSharedData.isMaster())
+    {
+        unmapObject(&myBulkSharedData);
+        myBulkSharedData.clearObjects();
+    }
+    foreach(SharedData* lane, myNodeLanes)
+    {
+        if(lane->isAttached() && !lane->isMaster())
+        {
+            unmapObject(lane);
+            lane->clearObjects();
+        }
+    }
+    if(myRelay != NULL && myRelay->isAttached())
+    {
+        deregisterObject(myRelay);
     }
 }
 
@@ -265,6 +481,69 @@ uint ConfigImpl::processMouseButtons(uint btns)
     return buttons;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void ConfigImpl::queueInput(InputRecord::Kind kind, int type, uint code, int x, int y, int wheel)
+{
+    InputRecord r;
+    r.kind = kind;
+    r.type = type;
+    r.code = code;
+    r.x = x;
+    r.y = y;
+    r.wheel = wheel;
+    r.time = FrameClock::now();
+
+    ServiceManager* sm = SystemManager::instance()->getServiceManager();
+    sm->lockEvents();
+    r.eventIndex = sm->getAvailableEvents();
+    myInputQueue.push(r);
+    sm->unlockEvents();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+uint64_t ConfigImpl::expandInputRecords(ServiceManager* sm)
+{
+    // Records are expanded at the end of the queue, after the service 
+    // events, which are written as they arrive. 
+    int numServiceEvents = sm->getAvailableEvents();
+    uint64_t inputTime = 0;
+    myInputRecordIndices.clear();
+    InputRecord r;
+    while(myInputQueue.pop(r))
+    {
+        if(inputTime == 0) inputTime = r.time;
+        myInputRecordIndices.push_back(min((int)r.eventIndex, numServiceEvents));
+        expandInputRecord(sm, r);
+    }
+
+    // Move each record before the service events that arrived after it.
+    int numRecords = myInputRecordIndices.size();
+    int numEvents = sm->getAvailableEvents();
+    if(numRecords == 0 || myInputRecordIndices[0] == numServiceEvents ||
+        numEvents != numServiceEvents + numRecords) return inputTime;
+
+    myInputEventBuffer.resize(numEvents * sizeof(Event));
+    for(int i = 0; i < numEvents; i++)
+    {
+        memcpy(&myInputEventBuffer[i * sizeof(Event)], sm->getEvent(i), sizeof(Event));
+    }
+    int next = 0;
+    int out = 0;
+    for(int i = 0; i < numRecords; i++)
+    {
+        for(; next < myInputRecordIndices[i]; next++)
+        {
+            memcpy(sm->getEvent(out++), &myInputEventBuffer[next * sizeof(Event)], sizeof(Event));
+        }
+        memcpy(sm->getEvent(out++), &myInputEventBuffer[(numServiceEvents + i) * sizeof(Event)], sizeof(Event));
+    }
+    for(; next < numServiceEvents; next++)
+    {
+        memcpy(sm->getEvent(out++), &myInputEventBuffer[next * sizeof(Event)], sizeof(Event));
+    }
+    return inputTime;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 bool ConfigImpl::handleEvent(const eq::ConfigEvent* event)
 { 
@@ -280,37 +559,45 @@ bool ConfigImpl::handleEvent(const eq::ConfigEvent* event)
             }
             else
             {
-                keyboardButtonCallback( event->data.key.key , Event::Down);
+                queueInput(InputRecord::KeyboardButton, Event::Down, event->data.key.key);
             }
             return true;   
         }
         case eq::Event::KEY_RELEASE:
         {
-            keyboardButtonCallback( event->data.key.key , Event::Up);
+            queueInput(InputRecord::KeyboardButton, Event::Up, event->data.key.key);
             return true;   
         }
     case eq::Event::WINDOW_POINTER_MOTION:
         {
-            mouseMotionCallback(event->data.pointer.x, event->data.pointer.y);
+            queueInput(InputRecord::PointerMotion, 0, 0, event->data.pointer.x, event->data.pointer.y);
             return true;
         }
     case eq::Event::WINDOW_POINTER_BUTTON_PRESS:
         {
             uint buttons = processMouseButtons(event->data.pointerButtonPress.buttons);
-            mouseButtonCallback(buttons, 1, event->data.pointer.x, event->data.pointer.y);
+            queueInput(InputRecord::PointerButton, 1, buttons, event->data.pointer.x, event->data.pointer.y);
             return true;
         }
     case eq::Event::WINDOW_POINTER_BUTTON_RELEASE:
         {
             uint buttons = processMouseButtons(event->data.pointerButtonPress.buttons);
-            mouseButtonCallback(buttons, 0, event->data.pointer.x, event->data.pointer.y);
+            queueInput(InputRecord::PointerButton, 0, buttons, event->data.pointer.x, event->data.pointer.y);
             return true;
         }
     case eq::Event::WINDOW_POINTER_WHEEL:
         {
             int wheel = event->data.pointerWheel.xAxis;
-            uint buttons = processMouseButtons(event->data.pointerButtonPress.buttons);
-            mouseWheelCallback(buttons, wheel, event->data.pointer.x, event->data.pointer.y);
+            queueInput(InputRecord::PointerWheel, 0, 0, event->data.pointer.x, event->data.pointer.y, wheel);
+            return true;
+        }
+    case FrameHashEvent:
+        {
+            // Frame hashes sent by slaves (see checkFrameState)
+            if(!myDivergenceCheck) break;
+            FrameHashReport r;
+            memcpy(&r, event->data.user.data, sizeof(r));
+            checkFrameHashReport(r);
             return true;
         }
     }
@@ -322,27 +609,31 @@ uint32_t ConfigImpl::startFrame( const uint128_t& version )
 {
     myServer->getDisplaySystem()->frameStarted();
 
-    static float lt = 0.0f;
-    static float tt = 0.0f;
-    // Compute dt.
-    float t = (float)myGlobalTimer.getElapsedTimeInSec();
-    if(lt == 0) lt = t;
+    // Compute time and dt. The clock works in double precision: we only 
+    // convert to float when filling the update context. uc.time loses 
+    // resolution as it grows (about 1ms after 4 hours): the exact time is 
+    // broadcast as the frame time (see EqualizerDisplaySystem::getFrameTime)
+    myFrameClock.tick();
     
     UpdateContext uc;
-    uc.dt = t - lt;
-    tt += uc.dt;
-    uc.time = tt;
+    uc.dt = (float)myFrameClock.getDt();
+    uc.time = (float)myFrameClock.getTime();
     uc.frameNum = version.low();
-    lt = t;
 
     mySharedData.setUpdateContext(uc);
+    mySharedData.setFrameTime(myFrameClock.getTimeUs());
+    myBulkSharedData.setUpdateContext(uc);
+    myBulkSharedData.setFrameTime(myFrameClock.getTimeUs());
 
     // Update fps stats every 10 frames.
-    if(uc.frameNum % 10 == 0 && uc.dt > 0.0f)
+    double rawDt = myFrameClock.getRawDt();
+    if(uc.frameNum % 10 == 0 && rawDt > 0)
     {
-        myFpsStat->addSample(1.0f / uc.dt);
+        myFpsStat->addSample(1.0 / rawDt);
     }
 
+    if(myReplay != NULL) return replayFrame(version);
+
     // If enabled, broadcast events to other server nodes.
     if(SystemManager::instance()->isMaster())
     {
@@ -352,17 +643,56 @@ uint32_t ConfigImpl::startFrame( const uint128_t& version )
         EventSharingModule::clearQueue();
 
         ServiceManager* im = SystemManager::instance()->getServiceManager();
-        im->poll();
+        if(myInputReplay != NULL) replayInput(im);
+        else im->poll();
+        uint64_t pollTime = FrameClock::now();
+        uint64_t inputTime = 0;
+
+        // Expand input records queued by the Equalizer windows since the
+        // last frame. Their ingestion time is kept in the records.
+        if(!myInputQueue.isEmpty())
+        {
+            im->lockEvents();
+            inputTime = expandInputRecords(im);
+            im->unlockEvents();
+        }
+
         int av = im->getAvailableEvents();
         //ofmsg("Events: %1%", %av);
         if(av != 0)
         {
             im->lockEvents();
+            // Service events are only stamped here, when they are drained, so
+            // their latency is underestimated by up to one frame.
+            if(inputTime == 0) inputTime = pollTime;
+
+            // Predict tracker and pointer poses at display time. The horizon 
+            // is the input-to-display latency measured on this node or, if
+            // the master does not render, one frame.
+            if(myPosePredictor.isEnabled())
+            {
+                double latency = myDisplayLatency.getAverage();
+                if(latency == 0) latency = myFrameClock.getRawDt() * 1000000.0;
+                myPosePredictor.setMeasuredLatency(latency);
+            }
+
             // Dispatch events to application server.
             for( int evtNum = 0; evtNum < av; evtNum++)
             {
                 Event* evt = im->getEvent(evtNum);
 
+                // Replayed events were captured after prediction.
+                if(myPosePredictor.isEnabled() && myInputReplay == NULL) 
+                {
+                    myPosePredictor.process(evt, pollTime, 
+                        pollTime > inputTime ? pollTime - inputTime : 0);
+                }
+                if(myInputCapture != NULL)
+                {
+                    const byte* bytes = (const byte*)evt;
+                    myInputCaptureBuffer.insert(myInputCaptureBuffer.end(), bytes, bytes + sizeof(Event));
+                }
+
                 myServer->handleEvent(*evt);
                 if(!EventSharingModule::isLocal(*evt))
                 {
@@ -375,21 +705,321 @@ uint32_t ConfigImpl::startFrame( const uint128_t& version )
             im->unlockEvents();
         }
         im->clearEvents();
+        // Replayed events keep the timestamps of the capture, and were not
+        // ingested by this run: input latency is not measured while replaying.
+        if(myInputReplay != NULL) inputTime = 0;
+        mySharedData.setInputTime(inputTime);
+
+        // One record per frame, empty if there was no input.
+        if(myInputCapture != NULL)
+        {
+            myInputCapture->append(uc.frameNum, myInputCaptureBuffer);
+            myInputCaptureBuffer.clear();
+        }
     }
 
-    // Send shared data.
+    // Send shared data. The priority lane goes out first.
+    mySharedData.setCommitClock(getTime());
     mySharedData.commit();
+    if(myRecording != NULL) mySharedData.recordFrame(myRecording);
+    if(!myNodeLanes.empty())
+    {
+        uint64_t laneBytes = 0;
+        foreach(SharedData* lane, myNodeLanes)
+        {
+            lane->commit();
+            laneBytes += lane->getLastFrameSize();
+        }
+        if(myNodeLaneBytesStat == NULL)
+        {
+            StatsManager* sm = SystemManager::instance()->getStatsManager();
+            myNodeLaneBytesStat = sm->createStat("shared node lane bytes", StatsManager::Count1);
+        }
+        myNodeLaneBytesStat->addSample((double)laneBytes);
+    }
 
     myServer->update(uc);
+    checkFrameState();
 
     // NOTE: This call NEEDS to stay after Engine::update, or frames will not update / display correctly.
     uint32_t res = eq::Config::startFrame(version);;
 
+    // The bulk lane is committed once the frame started, so serializing and
+    // sending it overlaps rendering instead of delaying Engine::update and
+    // the priority lane. Slaves do not wait for it: they usually apply it
+    // with the next frame. It still runs on this thread, so its cost adds
+    // to the master frame time when it exceeds the render time.
+    if(isBulkLaneEnabled())
+    {
+        myBulkSharedData.commit();
+        updateLaneStats(0);
+    }
+
     myServer->getDisplaySystem()->frameFinished();
 
     return res;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void ConfigImpl::setupRecording(Setting& s)
+{
+    // Recordings and input are handled by the master.
+    SystemManager* sys = SystemManager::instance();
+    if(!sys->isMaster()) return;
+
+    String recordPath = Config::getStringValue("sharedDataRecord", s, "");
+    String replayPath = Config::getStringValue("sharedDataReplay", s, "");
+    if(recordPath != "")
+    {
+        myRecording = new SharedDataRecording();
+        if(!myRecording->create(recordPath))
+        {
+            delete myRecording;
+            myRecording = NULL;
+        }
+    }
+    if(replayPath != "")
+    {
+        // Replayed frames are not sent: slaves would wait for them forever.
+        EqualizerDisplaySystem* eqds = (EqualizerDisplaySystem*)sys->getDisplaySystem();
+        DisplayConfig& dc = eqds->getDisplayConfig();
+        bool singleNode = true;
+        for(int n = 0; n < dc.numNodes; n++)
+        {
+            if(dc.nodes[n].isRemote && dc.nodes[n].enabled) singleNode = false;
+        }
+        myReplay = new SharedDataRecording();
+        if(!singleNode)
+        {
+            owarn("ConfigImpl: sharedDataReplay needs a single node configuration, replay disabled");
+            delete myReplay;
+            myReplay = NULL;
+        }
+        else if(!myReplay->open(replayPath))
+        {
+            delete myReplay;
+            myReplay = NULL;
+        }
+        else
+        {
+            ofmsg("ConfigImpl: replaying %1% shared data frames from %2%", 
+                %myReplay->getNumFrames() %replayPath);
+            // Replay runs on the master, so master-only code still runs.
+            owarn("ConfigImpl: replay runs on the master node, modules that change shared state on the master should check EqualizerDisplaySystem::isReplaying");
+        }
+    }
+
+    // Input capture and replay.
+    String capturePath = Config::getStringValue("inputCapture", s, "");
+    String inputReplayPath = Config::getStringValue("inputReplay", s, "");
+    if(capturePath != "")
+    {
+        myInputCapture = new SharedDataRecording();
+        if(!myInputCapture->create(capturePath, SharedDataRecording::InputCapture, sizeof(Event)))
+        {
+            delete myInputCapture;
+            myInputCapture = NULL;
+        }
+    }
+    if(inputReplayPath != "")
+    {
+        myInputReplay = new SharedDataRecording();
+        if(!myInputReplay->open(inputReplayPath, SharedDataRecording::InputCapture, sizeof(Event)))
+        {
+            delete myInputReplay;
+            myInputReplay = NULL;
+            return;
+        }
+        // Replayed frames advance time by a fixed step, so the master does
+        // the same work at each frame of every run.
+        if(myFrameClock.getFixedTimestep() <= 0)
+        {
+            myFrameClock.setFixedTimestep(Config::getFloatValue("inputReplayTimestep", s, 1.0f / 60));
+        }
+        ofmsg("ConfigImpl: replaying %1% input frames from %2% (time step %3% s)", 
+            %myInputReplay->getNumFrames() %inputReplayPath %myFrameClock.getFixedTimestep());
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ConfigImpl::replayInput(ServiceManager* sm)
+{
+    // Live input is dropped: services are not polled, and events queued by 
+    // the Equalizer windows are discarded.
+    InputRecord r;
+    while(myInputQueue.pop(r));
+    sm->clearEvents();
+
+    if(myInputReplayFrame == 0) myReplayTimer.start();
+    if(myInputReplayFrame >= myInputReplay->getNumFrames()) return;
+
+    uint64_t size;
+    const byte* data = myInputReplay->getFrame(myInputReplayFrame, NULL, &size);
+    int numEvents = size / sizeof(Event);
+    sm->lockEvents();
+    for(int i = 0; i < numEvents; i++)
+    {
+        memcpy(sm->writeHead(), data + i * sizeof(Event), sizeof(Event));
+    }
+    sm->unlockEvents();
+
+    if(++myInputReplayFrame == myInputReplay->getNumFrames())
+    {
+        double elapsed = myReplayTimer.getElapsedTimeInMilliSec();
+        ofmsg("ConfigImpl: replayed %1% input frames in %2% ms (%3% fps)",
+            %myInputReplayFrame %elapsed %(myInputReplayFrame * 1000.0 / elapsed));
+        SystemManager::instance()->postExitRequest();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+uint32_t ConfigImpl::replayFrame(const uint128_t& version)
+{
+    // Apply the next recorded version in place of input handling and 
+    // commit, the way a slave applies it in updateSharedData. Frames are 
+    // not paced, so this runs as fast as the update and draw allow.
+    if(myReplayApplyStat == NULL)
+    {
+        StatsManager* sm = SystemManager::instance()->getStatsManager();
+        myReplayApplyStat = sm->createStat("shared replay apply", StatsManager::Time);
+        myReplayTimer.start();
+    }
+
+    if(myReplayFrame < myReplay->getNumFrames())
+    {
+        uint32_t frameNum;
+        uint64_t size;
+        const byte* data = myReplay->getFrame(myReplayFrame, &frameNum, &size);
+        Timer timer;
+        timer.start();
+        mySharedData.applyRecordedFrame(data, size, myReplayFrame == 0);
+        mySharedData.finishApply();
+        double applyTime = timer.getElapsedTimeInMilliSec();
+        myReplayApplyStat->addSample(applyTime);
+        myReplayApplyTime += applyTime;
+
+        if(++myReplayFrame == myReplay->getNumFrames())
+        {
+            double elapsed = myReplayTimer.getElapsedTimeInMilliSec();
+            ofmsg("ConfigImpl: replayed %1% frames in %2% ms (%3% fps, apply %4% ms/frame)",
+                %myReplayFrame %elapsed %(myReplayFrame * 1000.0 / elapsed)
+                %(myReplayApplyTime / myReplayFrame));
+            SystemManager::instance()->postExitRequest();
+        }
+    }
+
+    myServer->update(mySharedData.getUpdateContext());
+
+    // NOTE: This call NEEDS to stay after Engine::update, or frames will not update / display correctly.
+    uint32_t res = eq::Config::startFrame(version);
+
+    myServer->getDisplaySystem()->frameFinished();
+
+    return res;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ConfigImpl::checkFrameState()
+{
+    if(!myDivergenceCheck) return;
+
+    SystemManager* sys = SystemManager::instance();
+    FrameHashReport r;
+    r.frameNum = mySharedData.getUpdateContext().frameNum;
+    r.port = 0;
+    r.nodeHash = 0;
+    r.streamHash = mySharedData.getStreamHash();
+    r.stateHash = 0;
+    if(!myDivergenceObjects.empty())
+    {
+        // Deferred updates need to be applied for the state to match.
+        if(!sys->isMaster()) mySharedData.finishApply();
+        r.stateHash = mySharedData.hashObjects(myDivergenceObjects);
+    }
+
+    if(sys->isMaster())
+    {
+        // The master hashes frame N before slaves start it, so its entry is
+        // always there when their reports arrive.
+        myFrameHashes[r.frameNum % FrameHashHistory] = r;
+    }
+    else
+    {
+        String hp = sys->getHostnameAndPort();
+        r.port = atoi(hp.substr(hp.rfind(':') + 1).c_str());
+        r.nodeHash = xxhash64(hp.c_str(), hp.size());
+        // The report (32 bytes) fits in the user event data.
+        eq::ConfigEvent event;
+        event.data.type = FrameHashEvent;
+        memcpy(event.data.user.data, &r, sizeof(r));
+        sendEvent(event);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ConfigImpl::checkFrameHashReport(const FrameHashReport& r)
+{
+    const FrameHashReport& m = myFrameHashes[r.frameNum % FrameHashHistory];
+    // Reports older than the history are dropped.
+    if(m.frameNum != r.frameNum) return;
+
+    if(myDivergenceStat == NULL)
+    {
+        StatsManager* sm = SystemManager::instance()->getStatsManager();
+        myDivergenceStat = sm->createStat("divergent frames", StatsManager::Count1);
+    }
+
+    // Only the first divergent frame of a node is reported.
+    bool& divergent = myDivergentNodes[r.nodeHash];
+    if(m.streamHash != r.streamHash || m.stateHash != r.stateHash)
+    {
+        myDivergenceStat->addSample(1);
+        if(!divergent)
+        {
+            oferror("ConfigImpl: node %1% diverged from the master at frame %2% (%3%)",
+                %getReportNode(r) %r.frameNum 
+                %(m.streamHash != r.streamHash ? "shared data" : "engine state"));
+            divergent = true;
+        }
+    }
+    else if(divergent)
+    {
+        ofmsg("ConfigImpl: node %1% matches the master again at frame %2%", %getReportNode(r) %r.frameNum);
+        divergent = false;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+String ConfigImpl::getReportNode(const FrameHashReport& r)
+{
+    // Only needed for messages: the node key table is built on first use.
+    if(myReportNodes.empty())
+    {
+        EqualizerDisplaySystem* eqds = (EqualizerDisplaySystem*)SystemManager::instance()->getDisplaySystem();
+        DisplayConfig& dc = eqds->getDisplayConfig();
+        for(int n = 0; n < dc.numNodes; n++)
+        {
+            String key = eqds->getNodeKey(dc.nodes[n]);
+            myReportNodes[xxhash64(key.c_str(), key.size())] = key;
+        }
+    }
+    Dictionary<uint64_t, String>::iterator it = myReportNodes.find(r.nodeHash);
+    if(it != myReportNodes.end()) return it->second;
+    return ostr("port %1%", %r.port);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool ConfigImpl::pollEvents()
+{
+    // Equalizer events (keyboard, mouse) get queued as input records by 
+    // handleEvent.
+    handleEvents();
+
+    ServiceManager* im = SystemManager::instance()->getServiceManager();
+    im->poll();
+    return im->getAvailableEvents() != 0 || !myInputQueue.isEmpty();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void ConfigImpl::updateSharedData( )
 {
@@ -404,7 +1034,100 @@ void ConfigImpl::updateSharedData( )
         //   EventSharingModule.updateSharedData
         //   SharedData.applyInstanceData
         //   SharedData.sync
+        Timer timer;
+        timer.start();
         mySharedData.sync(co::VERSION_NEXT);
+        // Objects this node is interested in.
+        if(!myNodeLanes.empty() && myNodeLanes.front()->isAttached())
+        {
+            myNodeLanes.front()->sync(co::VERSION_NEXT);
+        }
+        double syncTime = timer.getElapsedTimeInMilliSec();
+
+        // Input latency includes the time this version spent in transit.
+        int64_t transit = getTime() - mySharedData.getCommitClock();
+        if(transit > 0) mySharedData.addTransitTime((uint64_t)transit * 1000);
+
+        // Forward this version to the children of this node.
+        if(myRelay != NULL && myRelay->isAttached()) myRelay->commit();
+
+        // The bulk lane may lag: apply whatever arrived, without waiting.
+        if(myBulkSharedData.isAttached())
+        {
+            myBulkSharedData.sync(co::VERSION_HEAD);
+            updateLaneStats(syncTime);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ConfigImpl::createNodeLanes(Setting& s)
+{
+    SystemManager* sys = SystemManager::instance();
+    EqualizerDisplaySystem* eqds = (EqualizerDisplaySystem*)sys->getDisplaySystem();
+    DisplayConfig& dc = eqds->getDisplayConfig();
+    if(sys->isMaster())
+    {
+        for(int n = 0; n < dc.numNodes; n++)
+        {
+            DisplayNodeConfig& nc = dc.nodes[n];
+            if(!nc.isRemote) continue;
+            SharedData* lane = new SharedData();
+            lane->setSource(&mySharedData);
+            mySharedData.addNodeLane(eqds->getNodeKey(nc), lane);
+            myNodeLanes.push_back(lane);
+        }
+    }
+    else
+    {
+        myLocalNodeKey = sys->getHostnameAndPort();
+        SharedData* lane = new SharedData();
+        mySharedData.setLocalNode(myLocalNodeKey);
+        mySharedData.addNodeLane(myLocalNodeKey, lane);
+        myNodeLanes.push_back(lane);
+    }
+
+    // Interest sets from the configuration.
+    if(s.exists("sharedObjectInterest"))
+    {
+        Setting& interests = s["sharedObjectInterest"];
+        for(int i = 0; i < interests.getLength(); i++)
+        {
+            String id = interests[i].getName();
+            eqds->setSharedObjectInterest(id, getStringList(id, interests));
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ConfigImpl::updateLaneStats(double syncTime)
+{
+    if(myPriorityBytesStat == NULL)
+    {
+        StatsManager* sm = SystemManager::instance()->getStatsManager();
+        myPriorityBytesStat = sm->createStat("shared priority bytes", StatsManager::Count1);
+        myBulkBytesStat = sm->createStat("shared bulk bytes", StatsManager::Count1);
+        if(!mySharedData.isMaster())
+        {
+            myPrioritySyncStat = sm->createStat("shared priority wait", StatsManager::Time);
+            myBulkLagStat = sm->createStat("shared bulk lag", StatsManager::Time);
+        }
+    }
+    myPriorityBytesStat->addSample((double)mySharedData.getLastFrameSize());
+    // Slaves only count bulk versions applied in this frame.
+    if(myBulkSharedData.getFrameTime() != myLastBulkFrameTime)
+    {
+        myBulkBytesStat->addSample((double)myBulkSharedData.getLastFrameSize());
+        myLastBulkFrameTime = myBulkSharedData.getFrameTime();
+    }
+    if(myPrioritySyncStat != NULL)
+    {
+        // Age of the bulk data applied, relative to the priority lane, in ms.
+        uint64_t priorityTime = mySharedData.getFrameTime();
+        uint64_t bulkTime = myBulkSharedData.getFrameTime();
+        double lag = priorityTime > bulkTime ? (priorityTime - bulkTime) / 1000.0 : 0;
+        myPrioritySyncStat->addSample(syncTime);
+        myBulkLagStat->addSample(lag);
     }
 }
 
@@ -48,6 +48,12 @@ using namespace std;
 
 #ifndef OMEGA_OS_WIN
 #include <sys/stat.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <unistd.h>
+#else
+#include <winsock2.h>
+#include <ws2tcpip.h>
 #endif
 
 #define OMEGA_EQ_TMP_FILE "./.eqcfg.eqc"
@@ -59,119 +65,107 @@ using namespace std;
 // for getenv(), used to read the DISPLAY env variable
 #include <stdlib.h>
 
-///////////////////////////////////////////////////////////////////////////////////////////////////
-void EqualizerSharedOStream::write(const void* data, uint64_t size)
-{
-    myStream->write(data, size);
-}
-
-///////////////////////////////////////////////////////////////////////////////////////////////////
-SharedOStream& EqualizerSharedOStream::operator<< (const String& str)
-{
-    const uint64_t nElems = str.length();
-    write(&nElems, sizeof(nElems));
-    if (nElems > 0)
-        write(str.c_str(), nElems);
-
-
-    return *this;
-}
-
-///////////////////////////////////////////////////////////////////////////////////////////////////
-void EqualizerSharedIStream::read(void* data, uint64_t size)
+///////////////////////////////////////////////////////////////////////////////
+Vector<String> omega::getStringList(const String& name, Setting& s)
 {
-    myStream->read(data, size);
+    Vector<String> result;
+    if(s.exists(name))
+    {
+        Setting& list = s[name.c_str()];
+        for(int i = 0; i < list.getLength(); i++)
+        {
+            result.push_back((const char*)list[i]);
+        }
+    }
+    return result;
 }
 
-///////////////////////////////////////////////////////////////////////////////////////////////////
-SharedIStream& EqualizerSharedIStream::operator>> (String& str)
+///////////////////////////////////////////////////////////////////////////////
+// Returns the numeric addresses of a host. Loopback addresses are returned 
+// as "loopback", so they match across address families.
+Vector<String> resolveHost(const String& hostname)
 {
-    uint64_t nElems = 0;
-    read(&nElems, sizeof(nElems));
-    if (nElems > myStream->getRemainingBufferSize())
+    Vector<String> result;
+    String name = hostname;
+    if(name == "local" || name == "localhost")
     {
-        oferror("SharedDataServices: nElems(%1%) > getRemainingBufferSize(%2%)",
-            %nElems %myStream->getRemainingBufferSize());
+        result.push_back("loopback");
+        char buf[256];
+        if(gethostname(buf, sizeof(buf)) != 0) return result;
+        name = buf;
     }
-    oassert(nElems <= myStream->getRemainingBufferSize());
-    if (nElems == 0)
-        str.clear();
-    else
+
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = NULL;
+    if(getaddrinfo(name.c_str(), NULL, &hints, &res) != 0) return result;
+    for(addrinfo* ai = res; ai != NULL; ai = ai->ai_next)
     {
-        str.assign(static_cast< const char* >(myStream->getRemainingBuffer()),
-            nElems);
-        myStream->advanceBuffer(nElems);
+        char host[NI_MAXHOST];
+        if(getnameinfo(ai->ai_addr, (socklen_t)ai->ai_addrlen, host, sizeof(host), NULL, 0, NI_NUMERICHOST) == 0)
+        {
+            String addr = host;
+            if(StringUtils::startsWith(addr, "127.") || addr == "::1") addr = "loopback";
+            result.push_back(addr);
+        }
     }
-    return *this;
+    freeaddrinfo(res);
+    return result;
 }
 
-///////////////////////////////////////////////////////////////////////////////////////////////////
-void SharedData::registerObject(SharedObject* module, const String& sharedId)
+///////////////////////////////////////////////////////////////////////////////
+bool omega::isSameHost(const String& a, const String& b)
 {
-    //ofmsg("SharedData::registerObject: registering %1%", %sharedId);
-    myObjects[sharedId] = module;
+    if(a == b) return true;
+    Vector<String> aa = resolveHost(a);
+    Vector<String> ba = resolveHost(b);
+    foreach(String addr, aa)
+    {
+        if(find(ba.begin(), ba.end(), addr) != ba.end()) return true;
+    }
+    return false;
 }
 
-///////////////////////////////////////////////////////////////////////////////////////////////////
-void SharedData::unregisterObject(const String& sharedId)
+///////////////////////////////////////////////////////////////////////////////
+co::ConnectionDescriptionPtr omega::createNamedPipeConnectionDescription(const String& hostname, int port)
 {
-    //ofmsg("SharedData::unregisterObject: unregistering %1%", %sharedId);
-    myObjectsToUnregister.push_back(sharedId);
+#ifdef OMEGA_OS_WIN
+    // The pipe name includes the node host, so a peer on another host never
+    // opens a local pipe of the same port, and falls back to the next 
+    // connection.
+    co::ConnectionDescriptionPtr desc = new co::ConnectionDescription;
+    desc->type = co::CONNECTIONTYPE_NAMEDPIPE;
+    desc->setFilename(ostr("\\\\.\\pipe\\omega-eq-%1%-%2%", %hostname %port));
+    return desc;
+#else
+    return NULL;
+#endif
 }
 
-///////////////////////////////////////////////////////////////////////////////////////////////////
-void SharedData::getInstanceData(co::DataOStream& os)
+///////////////////////////////////////////////////////////////////////////////
+// Returns the wall block of a tile canvas, from the tile corners in the 
+// display configuration. Tiles without corners get the default wall.
+String buildTileWall(String& indent, DisplayTileConfig* tc)
 {
-    //omsg("#### SharedData::getInstanceData");
-    EqualizerSharedOStream eos(&os);
-    SharedOStream& out = eos;
-
-    // Serialize update context.
-    out << myUpdateContext.frameNum << myUpdateContext.dt << myUpdateContext.time;
-
-    int numObjects = myObjects.size();
-    out << numObjects;
-
-    foreach(SharedObjectItem obj, myObjects)
+    String result;
+    START_BLOCK(result, "wall");
+    if(tc->bottomLeft == tc->bottomRight || tc->bottomLeft == tc->topLeft)
     {
-        out << obj.getKey();
-        obj->commitSharedData(out);
+        result +=
+            L("bottom_left [ -1 -0.5 0 ]") +
+            L("bottom_right [ 1 -0.5 0 ]") +
+            L("top_left [ -1 0.5 0 ]");
+        END_BLOCK(result);
+        return result;
     }
-
-    foreach(String id, myObjectsToUnregister) myObjects.erase(id);
-
-}
-
-///////////////////////////////////////////////////////////////////////////////////////////////////
-void SharedData::applyInstanceData(co::DataIStream& is)
-{
-    //omsg("#### SharedData::applyInstanceData");
-    EqualizerSharedIStream eis(&is);
-    SharedIStream& in = eis;
-
-    // Desrialize update context.
-    in >> myUpdateContext.frameNum >> myUpdateContext.dt >> myUpdateContext.time;
-
-    int numObjects;
-    in >> numObjects;
-
-    while (numObjects > 0)
-    {
-        String objId;
-        in >> objId;
-
-        SharedObject* obj = myObjects[objId];
-        if (obj != NULL)
-        {
-            obj->updateSharedData(in);
-        }
-        else
-        {
-            oferror("FATAL ERROR: SharedDataServices::applyInstanceData: could not find object key %1%", %objId);
-        }
-
-        numObjects--;
-    };
+    result +=
+        L(ostr("bottom_left [ %1% %2% %3% ]", %tc->bottomLeft[0] %tc->bottomLeft[1] %tc->bottomLeft[2])) +
+        L(ostr("bottom_right [ %1% %2% %3% ]", %tc->bottomRight[0] %tc->bottomRight[1] %tc->bottomRight[2])) +
+        L(ostr("top_left [ %1% %2% %3% ]", %tc->topLeft[0] %tc->topLeft[1] %tc->topLeft[2]));
+    END_BLOCK(result);
+    return result;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -186,6 +180,15 @@ EqualizerDisplaySystem::EqualizerDisplaySystem():
     mySys(NULL),
     myConfig(NULL),
     myNodeFactory(NULL),
+    myFramePacer(NULL),
+    myFrameExporter(NULL),
+    myFrameExportBuffers(3),
+    myHotReconfiguration(false),
+    myThreadAffinity(NULL),
+    myRelayFanout(0),
+    myNamedPipeTransport(false),
+    myLogStreamBuf(NULL),
+    myLogStream(NULL),
     myDebugMouse(false)
 {
 }
@@ -201,7 +204,26 @@ void EqualizerDisplaySystem::exitConfig()
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void EqualizerDisplaySystem::generateEqConfig()
+void EqualizerDisplaySystem::requestRedraw()
+{
+    if(myFramePacer != NULL) myFramePacer->requestRedraw();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+double EqualizerDisplaySystem::getFrameTime()
+{
+    if(myConfig == NULL) return 0;
+    return myConfig->getFrameTime() / 1000000.0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool EqualizerDisplaySystem::isReplaying()
+{
+    return myConfig != NULL && myConfig->isReplaying();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+String EqualizerDisplaySystem::generateEqConfig()
 {
     DisplayConfig& eqcfg = myDisplayConfig;
     String indent = "";
@@ -258,6 +280,18 @@ void EqualizerDisplaySystem::generateEqConfig()
         {
             int port = eqcfg.basePort + nc.port;
             START_BLOCK(result, "node");
+            // Peers on the same host try the named pipe first, everybody 
+            // else falls back to TCP.
+            co::ConnectionDescriptionPtr local = createNamedPipeConnectionDescription(nc.hostname, port);
+            if(myNamedPipeTransport && local != NULL && hasLocalPeers(nc))
+            {
+                START_BLOCK(result, "connection");
+                result +=
+                    L("type NAMEDPIPE") +
+                    L("filename \"" + local->getFilename() + "\"");
+                END_BLOCK(result);
+                ofmsg("EqualizerDisplaySystem: node %1% uses a named pipe connection", %nc.hostname);
+            }
             START_BLOCK(result, "connection");
             result +=
                 L("type TCPIP") +
@@ -315,12 +349,64 @@ void EqualizerDisplaySystem::generateEqConfig()
 
     typedef pair<String, DisplayTileConfig*> TileIterator;
 
+    if(myHotReconfiguration)
+    {
+        // One canvas per tile, with the tile layout and an OFF layout. 
+        // Switching a canvas to OFF deactivates its tile, and Equalizer shuts 
+        // down pipes and nodes left with no active tiles. The first layout 
+        // listed is active at startup: tiles of standby nodes start OFF.
+        foreach(TileIterator p, eqcfg.tiles)
+        {
+            DisplayTileConfig* tc = p.second;
+            if(tc->node && tc->node->enabled)
+            {
+                START_BLOCK(result, "layout");
+                result +=
+                    L(ostr("name \"layout-%1%\"", %tc->name)) +
+                    L(ostr("view { name \"view-%1%\" }", %tc->name));
+                END_BLOCK(result);
+            }
+        }
+        foreach(TileIterator p, eqcfg.tiles)
+        {
+            DisplayTileConfig* tc = p.second;
+            if(tc->node && tc->node->enabled)
+            {
+                bool standby = 
+                    find(myStandbyNodes.begin(), myStandbyNodes.end(), tc->node->hostname) != myStandbyNodes.end();
+                String layout = ostr("layout \"layout-%1%\"", %tc->name);
+                START_BLOCK(result, "canvas");
+                result += L(ostr("name \"canvas-%1%\"", %tc->name));
+                if(standby) result += L("layout OFF") + L(layout);
+                else result += L(layout) + L("layout OFF");
+                result += buildTileWall(indent, tc);
+                result += L(ostr("segment { name \"segment-%1%\" channel \"%1%\" }", %tc->name));
+                END_BLOCK(result);
+            }
+        }
+    }
+
     // compounds
     START_BLOCK(result, "compound")
     foreach(TileIterator p, eqcfg.tiles)
     {
         DisplayTileConfig* tc = p.second;
-        if(tc->node && tc->node->enabled)
+        if(tc->node && tc->node->enabled && myHotReconfiguration)
+        {
+            // Destination channels are created by Equalizer for each 
+            // segment / view pair: the frustum comes from the canvas wall.
+            String channel = ostr("channel ( canvas \"canvas-%1%\" segment \"segment-%1%\" layout \"layout-%1%\" view \"view-%1%\" )", 
+                %tc->name);
+            if(eqcfg.enableSwapSync)
+            {
+                result += L(ostr("compound { swapbarrier { name \"defaultbarrier\" } %1% task [DRAW] }", %channel));
+            }
+            else
+            {
+                result += L(ostr("compound { %1% task [DRAW] }", %channel));
+            }
+        }
+        else if(tc->node && tc->node->enabled)
         {
             if(eqcfg.enableSwapSync)
             {
@@ -357,6 +443,16 @@ void EqualizerDisplaySystem::generateEqConfig()
     // end server
     END_BLOCK(result)
 
+    // Shared data relay tree (informational: the tree is built by every node
+    // from the display configuration).
+    typedef Dictionary<String, String>::Item RelayItem;
+    foreach(RelayItem r, myRelayParents)
+    {
+        String parent = r.second.empty() ? "master" : r.second;
+        result += L(ostr("# relay: %1% -> %2%", %r.first %parent));
+        ofmsg("EqualizerDisplaySystem: relay %1% -> %2%", %r.first %parent);
+    }
+
     if(!eqcfg.disableConfigGenerator)
     {
         FILE* f = fopen(OMEGA_EQ_TMP_FILE, "w");
@@ -374,6 +470,7 @@ void EqualizerDisplaySystem::generateEqConfig()
             oerror("EqualizerDisplaySystem FATAL: could not create configuration file " OMEGA_EQ_TMP_FILE " - check for write permissions");
         }
     }
+    return result;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -444,6 +541,418 @@ void EqualizerDisplaySystem::setupEqInitArgs(int& numArgs, const char** argv)
         argv[3] = SystemManager::instance()->getHostnameAndPort().c_str();
         numArgs = 4;
     }
+
+    if(myNamedPipeTransport)
+    {
+        // Listen on the named pipe too. Slaves use their node host and port
+        // (the names written in the configuration), the master application
+        // node the base port. The master also needs an explicit TCP 
+        // listener: Collage only adds its default one when no listener is 
+        // given.
+        String host = "master";
+        int port = myDisplayConfig.basePort;
+        if(!sys->isMaster())
+        {
+            String hp = sys->getHostnameAndPort();
+            host = hp.substr(0, hp.rfind(':'));
+            port = atoi(hp.substr(hp.rfind(':') + 1).c_str());
+        }
+        co::ConnectionDescriptionPtr local = createNamedPipeConnectionDescription(host, port);
+        if(local != NULL)
+        {
+            if(sys->isMaster())
+            {
+                co::ConnectionDescriptionPtr tcp = new co::ConnectionDescription;
+                tcp->type = co::CONNECTIONTYPE_TCPIP;
+                myTcpListenArg = tcp->toString();
+                argv[numArgs++] = "--eq-listen";
+                argv[numArgs++] = myTcpListenArg.c_str();
+            }
+            myPipeListenArg = local->toString();
+            argv[numArgs++] = "--eq-listen";
+            argv[numArgs++] = myPipeListenArg.c_str();
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool EqualizerDisplaySystem::hasLocalPeers(const DisplayNodeConfig& nc)
+{
+    // Nodes without a remote hostname run on the master.
+    if(isSameHost(nc.hostname, "local")) return true;
+    for(int n = 0; n < myDisplayConfig.numNodes; n++)
+    {
+        DisplayNodeConfig& other = myDisplayConfig.nodes[n];
+        if(&other == &nc || !other.enabled) continue;
+        if(isSameHost(nc.hostname, other.hostname)) return true;
+    }
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+Setting* EqualizerDisplaySystem::getDisplaySettings()
+{
+    // Equalizer-specific options are read from the same section as the 
+    // standard display configuration.
+    Config* cfg = SystemManager::instance()->getAppConfig();
+    if(cfg == NULL || !cfg->exists("config/display")) return NULL;
+    return &cfg->lookup("config/display");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EqualizerDisplaySystem::readDisplayOptions()
+{
+    Setting* ps = getDisplaySettings();
+    if(ps == NULL) return;
+    Setting& s = *ps;
+
+    if(Config::getBoolValue("frameExport", s, false))
+    {
+        // Double buffering is the minimum that lets us map a buffer that is
+        // not being written to in the current frame.
+        myFrameExportBuffers = max(2, Config::getIntValue("frameExportBuffers", s, 3));
+        int maxQueuedFrames = max(1, Config::getIntValue("frameExportQueueLength", s, 4));
+        myFrameExporter = new FrameExporter(maxQueuedFrames);
+        myFrameExporter->start();
+        ofmsg("EqualizerDisplaySystem: frame export enabled (%1% readback buffers, queue length %2%)",
+            %myFrameExportBuffers %maxQueuedFrames);
+    }
+
+    myHotReconfiguration = Config::getBoolValue("hotReconfiguration", s, false);
+    myStandbyNodes = getStringList("standbyNodes", s);
+
+    myNamedPipeTransport = Config::getBoolValue("namedPipeTransport", s, false);
+    if(myNamedPipeTransport && createNamedPipeConnectionDescription("", 0) == NULL)
+    {
+        owarn("EqualizerDisplaySystem: namedPipeTransport is only supported on windows, same-host nodes use TCP");
+        myNamedPipeTransport = false;
+    }
+
+    myRelayFanout = max(0, Config::getIntValue("sharedDataRelayFanout", s, 0));
+    if(myRelayFanout > 0)
+    {
+        owarn("EqualizerDisplaySystem: shared data relay enabled: a relay node that fails or stalls also stalls the nodes below it");
+    }
+    if(myRelayFanout > 0 && myHotReconfiguration)
+    {
+        owarn("EqualizerDisplaySystem: the relay tree does not follow hot reconfiguration, nodes below an inactive relay will stall");
+    }
+
+    String affinity = Config::getStringValue("threadAffinity", s, "none");
+    if(affinity != "none")
+    {
+        myThreadAffinity = new ThreadAffinity();
+        myThreadAffinity->setup(s);
+    }
+
+    if(Config::getBoolValue("logEqualizer", s, false))
+    {
+        myLogStreamBuf = new EqualizerLogStreamBuf();
+        myLogStreamBuf->setRateLimit(
+            Config::getIntValue("logRateLimit", s, 5),
+            Config::getIntValue("logRateInterval", s, 1000));
+        myLogStream = new std::ostream(myLogStreamBuf);
+        co::base::Log::setOutput(*myLogStream);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EqualizerDisplaySystem::setTileActive(const String& tileName, bool active)
+{
+    if(!myHotReconfiguration)
+    {
+        ofwarn("EqualizerDisplaySystem::setTileActive: hot reconfiguration is disabled, ignoring %1%", %tileName);
+        return;
+    }
+    myTileActivationLock.lock();
+    myTileActivation.push_back(pair<String, bool>(tileName, active));
+    myTileActivationLock.unlock();
+    requestRedraw();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EqualizerDisplaySystem::setNodeActive(const String& hostname, bool active)
+{
+    for(int n = 0; n < myDisplayConfig.numNodes; n++)
+    {
+        DisplayNodeConfig& nc = myDisplayConfig.nodes[n];
+        if(nc.hostname == hostname)
+        {
+            for(int i = 0; i < nc.numTiles; i++) setTileActive(nc.tiles[i]->name, active);
+            return;
+        }
+    }
+    ofwarn("EqualizerDisplaySystem::setNodeActive: unknown node %1%", %hostname);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EqualizerDisplaySystem::rejoinNode(const String& hostname)
+{
+    if(!myHotReconfiguration)
+    {
+        ofwarn("EqualizerDisplaySystem::rejoinNode: hot reconfiguration is disabled, ignoring %1%", %hostname);
+        return;
+    }
+    setNodeActive(hostname, false);
+    myTileActivationLock.lock();
+    myNodesToLaunch.push_back(hostname);
+    myTileActivationLock.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EqualizerDisplaySystem::updateNodeRejoin()
+{
+    myTileActivationLock.lock();
+    List<String> nodesToLaunch = myNodesToLaunch;
+    myNodesToLaunch.clear();
+    myTileActivationLock.unlock();
+
+    // The nodes have been deactivated by applyTileActivation: launch them 
+    // again. We do not wait for them here, so the rest of the cluster keeps
+    // rendering.
+    uint64_t now = FrameClock::now();
+    foreach(String hostname, nodesToLaunch)
+    {
+        for(int n = 0; n < myDisplayConfig.numNodes; n++)
+        {
+            DisplayNodeConfig& nc = myDisplayConfig.nodes[n];
+            if(nc.hostname == hostname && nc.hostname != "local")
+            {
+                ofmsg("EqualizerDisplaySystem: relaunching node %1%", %hostname);
+                launchNode(nc);
+                myLaunchedNodes[hostname] = now;
+            }
+        }
+    }
+
+    // Reactivate nodes once they had the same time to start as at launch.
+    if(myLaunchedNodes.empty()) return;
+    uint64_t interval = (uint64_t)myDisplayConfig.launcherInterval * 1000;
+    List<String> readyNodes;
+    typedef Dictionary<String, uint64_t>::Item LaunchItem;
+    foreach(LaunchItem item, myLaunchedNodes)
+    {
+        if(now - item.second >= interval) readyNodes.push_back(item.getKey());
+    }
+    foreach(String hostname, readyNodes)
+    {
+        myLaunchedNodes.erase(hostname);
+        setNodeActive(hostname, true);
+    }
+    // Keep frames coming in on-demand redraw mode, or we would never get 
+    // here again to reactivate the nodes.
+    if(!myLaunchedNodes.empty()) requestRedraw();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EqualizerDisplaySystem::applyTileActivation()
+{
+    myTileActivationLock.lock();
+    List< pair<String, bool> > changes = myTileActivation;
+    myTileActivation.clear();
+    myTileActivationLock.unlock();
+    if(changes.empty()) return;
+
+    typedef pair<String, bool> TileActivation;
+    foreach(TileActivation c, changes)
+    {
+        eq::Canvas* canvas = myConfig->find<eq::Canvas>("canvas-" + c.first);
+        if(canvas == NULL)
+        {
+            ofwarn("EqualizerDisplaySystem: no canvas for tile %1%", %c.first);
+            continue;
+        }
+        // The canvas has two layouts: the tile layout and OFF (NULL).
+        for(uint32_t i = 0; i < canvas->getLayouts().size(); i++)
+        {
+            if((canvas->getLayouts()[i] != NULL) == c.second)
+            {
+                canvas->useLayout(i);
+                break;
+            }
+        }
+        ofmsg("EqualizerDisplaySystem: tile %1% %2%", %c.first %(c.second ? "activated" : "deactivated"));
+    }
+
+    // Commits the canvas changes, and starts or stops the affected 
+    // channels, windows, pipes and nodes.
+    Timer timer;
+    timer.start();
+    if(!myConfig->update())
+    {
+        oerror("EqualizerDisplaySystem: configuration update failed");
+    }
+    ofmsg("EqualizerDisplaySystem: configuration updated in %1% ms", %(int)timer.getElapsedTimeInMilliSec());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EqualizerDisplaySystem::addFrameExportListener(FrameExportListener* listener)
+{
+    if(myFrameExporter == NULL)
+    {
+        owarn("EqualizerDisplaySystem::addFrameExportListener: frame export is disabled (set frameExport = true in the display configuration)");
+        return;
+    }
+    myFrameExporter->addListener(listener);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EqualizerDisplaySystem::removeFrameExportListener(FrameExportListener* listener)
+{
+    if(myFrameExporter != NULL) myFrameExporter->removeListener(listener);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EqualizerDisplaySystem::sendSharedStream(const String& streamId, const void* data, uint64 size)
+{
+    if(!SystemManager::instance()->isMaster()) return;
+    if(myConfig == NULL)
+    {
+        ofwarn("EqualizerDisplaySystem::sendSharedStream: display not initialized, dropping stream %1%", %streamId);
+        return;
+    }
+    myConfig->getSharedData()->sendStream(streamId, data, size);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EqualizerDisplaySystem::addSharedStreamListener(SharedStreamListener* listener)
+{
+    if(myConfig == NULL)
+    {
+        owarn("EqualizerDisplaySystem::addSharedStreamListener: display not initialized");
+        return;
+    }
+    myConfig->getSharedData()->addStreamListener(listener);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EqualizerDisplaySystem::removeSharedStreamListener(SharedStreamListener* listener)
+{
+    if(myConfig != NULL) myConfig->getSharedData()->removeStreamListener(listener);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+String EqualizerDisplaySystem::getNodeKey(const DisplayNodeConfig& nc)
+{
+    // Same as the hostname:port the node listens on.
+    return ostr("%1%:%2%", %nc.hostname %(myDisplayConfig.basePort + nc.port));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EqualizerDisplaySystem::setSharedObjectInterest(const String& objectId, const Vector<String>& names)
+{
+    if(myConfig == NULL)
+    {
+        ofwarn("EqualizerDisplaySystem::setSharedObjectInterest: display not initialized, ignoring %1%", %objectId);
+        return;
+    }
+
+    Vector<String> nodes;
+    foreach(String name, names)
+    {
+        bool found = false;
+        if(myDisplayConfig.tiles.find(name) != myDisplayConfig.tiles.end())
+        {
+            DisplayTileConfig* tc = myDisplayConfig.tiles[name];
+            if(tc->node != NULL && tc->node->isRemote) nodes.push_back(getNodeKey(*tc->node));
+            found = true;
+        }
+        for(int n = 0; n < myDisplayConfig.numNodes; n++)
+        {
+            DisplayNodeConfig& nc = myDisplayConfig.nodes[n];
+            if(nc.hostname == name)
+            {
+                if(nc.isRemote) nodes.push_back(getNodeKey(nc));
+                found = true;
+            }
+        }
+        if(!found) ofwarn("EqualizerDisplaySystem::setSharedObjectInterest: unknown tile or node %1%", %name);
+    }
+    ofmsg("EqualizerDisplaySystem: shared object %1% sent to %2% of %3% nodes", 
+        %objectId %nodes.size() %myDisplayConfig.numNodes);
+    myConfig->getSharedData()->setObjectInterest(objectId, nodes);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EqualizerDisplaySystem::buildRelayTree()
+{
+    // A fanout-ary tree over the remote nodes, with the master as root: the
+    // first fanout nodes are children of the master, and node i is a child 
+    // of node i / fanout - 1. All nodes build the same tree from the display 
+    // configuration.
+    myRelayParents.clear();
+    if(myRelayFanout <= 0) return;
+
+    Vector<String> keys;
+    for(int n = 0; n < myDisplayConfig.numNodes; n++)
+    {
+        DisplayNodeConfig& nc = myDisplayConfig.nodes[n];
+        if(nc.isRemote && nc.enabled) keys.push_back(getNodeKey(nc));
+    }
+    for(int i = 0; i < keys.size(); i++)
+    {
+        myRelayParents[keys[i]] = i < myRelayFanout ? "" : keys[i / myRelayFanout - 1];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+String EqualizerDisplaySystem::getRelayParent(const String& nodeKey)
+{
+    Dictionary<String, String>::iterator it = myRelayParents.find(nodeKey);
+    if(it == myRelayParents.end()) return "";
+    return it->second;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool EqualizerDisplaySystem::hasRelayChildren(const String& nodeKey)
+{
+    typedef Dictionary<String, String>::Item RelayItem;
+    foreach(RelayItem r, myRelayParents)
+    {
+        if(r.second == nodeKey) return true;
+    }
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EqualizerDisplaySystem::setSharedObjectLane(const String& objectId, bool bulk)
+{
+    if(myConfig == NULL)
+    {
+        ofwarn("EqualizerDisplaySystem::setSharedObjectLane: display not initialized, ignoring %1%", %objectId);
+        return;
+    }
+    myConfig->getSharedData()->setObjectLane(objectId, 
+        bulk ? SharedData::BulkLane : SharedData::PriorityLane);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EqualizerDisplaySystem::launchNode(DisplayNodeConfig& nc)
+{
+    String executable = StringUtils::replaceAll(myDisplayConfig.nodeLauncher, "%c", SystemManager::instance()->getApplication()->getExecutableName());
+    executable = StringUtils::replaceAll(executable, "%h", nc.hostname);
+
+    // Substitute %d with current working directory
+    String cCurrentPath = ogetcwd();
+    executable = StringUtils::replaceAll(executable, "%d", cCurrentPath);
+
+    // Setup the executable call. Note: we pass a-D argument to tell all
+    // instances what the main data directory is. We use ogetdataprefix
+    // because omain sets the data prefix to the root data dir during
+    // startup.
+    int port = myDisplayConfig.basePort + nc.port;
+    
+    const Rect& ic = myDisplayConfig.getCanvasRect();
+    String initialCanvas = ostr("%1%,%2%,%3%,%4%", %ic.x() %ic.y() %ic.width() %ic.height());
+    
+    String cmd = ostr("%1% -c %2%@%3%:%4% -D %5% -w %6%", 
+        %executable 
+        %SystemManager::instance()->getAppConfig()->getFilename() 
+        %nc.hostname 
+        %port 
+        %ogetdataprefix() 
+        %initialCanvas);
+    olaunch(cmd);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -453,6 +962,9 @@ void EqualizerDisplaySystem::initialize(SystemManager* sys)
     else Log::level = LOG_WARN;
     mySys = sys;
 
+    readDisplayOptions();
+    buildRelayTree();
+
     //atexit(::exitConfig);
 
     // Launch application instances on secondary nodes.
@@ -464,34 +976,7 @@ void EqualizerDisplaySystem::initialize(SystemManager* sys)
         for(int n = 0; n < myDisplayConfig.numNodes; n++)
         {
             DisplayNodeConfig& nc = myDisplayConfig.nodes[n];
-
-            if(nc.hostname != "local" && nc.enabled)
-            {
-                String executable = StringUtils::replaceAll(myDisplayConfig.nodeLauncher, "%c", SystemManager::instance()->getApplication()->getExecutableName());
-                executable = StringUtils::replaceAll(executable, "%h", nc.hostname);
-            
-                // Substitute %d with current working directory
-                String cCurrentPath = ogetcwd();
-                executable = StringUtils::replaceAll(executable, "%d", cCurrentPath);
-            
-                // Setup the executable call. Note: we pass a-D argument to tell all
-                // instances what the main data directory is. We use ogetdataprefix
-                // because omain sets the data prefix to the root data dir during
-                // startup.
-                int port = myDisplayConfig.basePort + nc.port;
-                
-                const Rect& ic = myDisplayConfig.getCanvasRect();
-                String initialCanvas = ostr("%1%,%2%,%3%,%4%", %ic.x() %ic.y() %ic.width() %ic.height());
-                
-                String cmd = ostr("%1% -c %2%@%3%:%4% -D %5% -w %6%", 
-                    %executable 
-                    %SystemManager::instance()->getAppConfig()->getFilename() 
-                    %nc.hostname 
-                    %port 
-                    %ogetdataprefix() 
-                    %initialCanvas);
-                olaunch(cmd);
-            }
+            if(nc.hostname != "local" && nc.enabled) launchNode(nc);
         }
         osleep(myDisplayConfig.launcherInterval);
     }
@@ -512,17 +997,60 @@ void EqualizerDisplaySystem::killCluster()
     if(SystemManager::instance()->isMaster())
     {
         ofmsg("number of nodes: %1%", %myDisplayConfig.numNodes);
+
+        NodeKiller::Options opts;
+        opts.killCommand = myDisplayConfig.nodeKiller;
+        opts.timeout = 5;
+        Setting* s = getDisplaySettings();
+        if(s != NULL)
+        {
+            opts.checkCommand = Config::getStringValue("nodeCheckCommand", *s, "");
+            opts.escalationCommand = Config::getStringValue("nodeKillEscalation", *s, "");
+            opts.timeout = Config::getFloatValue("nodeKillTimeout", *s, opts.timeout);
+        }
+
+        // Kill all remote nodes concurrently, and wait until each one is 
+        // confirmed down or gave up (after two timeouts, if escalation is
+        // enabled).
+        Vector<NodeKiller*> killers;
         for(int n = 0; n < myDisplayConfig.numNodes; n++)
         {
             DisplayNodeConfig& nc = myDisplayConfig.nodes[n];
             
             if(nc.hostname != "local" && nc.enabled && myDisplayConfig.nodeKiller != "")
             {
-                String executable = StringUtils::replaceAll(myDisplayConfig.nodeKiller, "%c", procName);
-                executable = StringUtils::replaceAll(executable, "%h", nc.hostname);
-                olaunch(executable);
+                NodeKiller* k = new NodeKiller(opts, procName, nc.hostname, 
+                    myDisplayConfig.basePort + nc.port);
+                k->start();
+                killers.push_back(k);
             }
         }
+
+        Timer timer;
+        timer.start();
+        // Check commands may be slow: stop waiting a second after the last
+        // kill step should have completed.
+        double maxWait = (opts.timeout * 2 + 1) * 1000;
+        bool done = false;
+        while(!done && timer.getElapsedTimeInMilliSec() < maxWait)
+        {
+            done = true;
+            foreach(NodeKiller* k, killers) if(!k->isDone()) done = false;
+            if(!done) osleep(50);
+        }
+
+        // Stragglers exit after their current check.
+        int confirmed = 0;
+        foreach(NodeKiller* k, killers)
+        {
+            k->stop();
+            k->join();
+            if(k->isConfirmed()) confirmed++;
+            else ofwarn("killCluster: node %1% not confirmed down", %k->getHostname());
+            delete k;
+        }
+        ofmsg("killCluster: %1% of %2% nodes confirmed down in %3% ms", 
+            %confirmed %killers.size() %(int)timer.getElapsedTimeInMilliSec());
     }
     
     // kindof hack but it works: kill master instance.
@@ -559,7 +1087,7 @@ void EqualizerDisplaySystem::finishInitialize(ConfigImpl* config, Engine* engine
 void EqualizerDisplaySystem::run()
 {
     bool error = false;
-    const char* argv[4];
+    const char* argv[8];
     int numArgs = 0;
     setupEqInitArgs(numArgs, (const char**)argv);
     myNodeFactory = new EqualizerNodeFactory();
@@ -581,10 +1109,25 @@ void EqualizerDisplaySystem::run()
             olog(Verbose, "<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<< DISPLAY INITIALIZATION\n\n");
             olog(Verbose, ">>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>> APPLICATION LOOP");
 
+            myFramePacer = new FramePacer();
+            Setting* s = getDisplaySettings();
+            if(s != NULL) myFramePacer->setup(*s);
+            myConfig->getSharedData()->setChangeTrackingEnabled(
+                myFramePacer->isIdleFrameSkipEnabled());
+
             uint32_t spin = 0;
             bool exitRequestProcessed = false;
             while(!SystemManager::instance()->isExitRequested())
             {
+                // Replays run at full speed.
+                if(!myConfig->isReplaying() && !myFramePacer->waitForFrame(myConfig)) continue;
+                if(myHotReconfiguration)
+                {
+                    applyTileActivation();
+                    updateNodeRejoin();
+                }
+                myFramePacer->frameStarted();
+
                 myConfig->startFrame( spin );
                 myConfig->finishFrame();
                 spin++;
@@ -625,5 +1168,26 @@ void EqualizerDisplaySystem::cleanup()
     }
 
     delete myNodeFactory;
+    delete myFramePacer;
+    myFramePacer = NULL;
+    delete myThreadAffinity;
+    myThreadAffinity = NULL;
     SharedDataServices::cleanup();
+
+    if(myFrameExporter != NULL)
+    {
+        myFrameExporter->shutdown();
+        delete myFrameExporter;
+        myFrameExporter = NULL;
+    }
+
+    if(myLogStream != NULL)
+    {
+        co::base::Log::setOutput(std::cout);
+        delete myLogStream;
+        // Stops the log thread after the pending messages are logged.
+        delete myLogStreamBuf;
+        myLogStream = NULL;
+        myLogStreamBuf = NULL;
+    }
 }
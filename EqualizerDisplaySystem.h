@@ -49,27 +49,56 @@ namespace omega
     class ViewImpl;
     class ConfigImpl;
     class Engine;
+    class FrameExporter;
+    class FramePacer;
+    class LogSink;
+    class ThreadAffinity;
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+    //! Receives frames rendered by the local Equalizer channels. Frames are read
+    //! back asynchronously and delivered on a worker thread, so listeners can 
+    //! record or stream them without stalling the pipe threads. Pixels are 
+    //! RGBA, 8 bits per component, with the bottom row first.
+    //! Frame export needs to be enabled in the display configuration 
+    //! (frameExport = true).
+    class FrameExportListener: public ReferenceType
+    {
+    public:
+        virtual void onFrameExported(const String& channelName, uint64 frameNum, 
+            int width, int height, const byte* pixels) = 0;
+    };
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+    //! Receives payloads sent with EqualizerDisplaySystem::sendSharedStream.
+    //! Called on the main thread of every node once the whole payload 
+    //! arrived (on the master, once its last chunk has been sent).
+    class SharedStreamListener: public ReferenceType
+    {
+    public:
+        virtual void onSharedStreamCompleted(const String& streamId, 
+            const byte* data, uint64 size) = 0;
+    };
 
     ///////////////////////////////////////////////////////////////////////////////////////////////
     // This class is used to route equalizer log into the omega log system.
+    // Characters are collected into lines on the writing thread, and complete
+    // lines are handed without locking to a background thread, that tags 
+    // them with the writing thread, rate-limits repeated messages and logs 
+    // them. Rendering threads never wait on the omega log.
     class EqualizerLogStreamBuf: public std::streambuf
     {
+    public:
+        EqualizerLogStreamBuf();
+        virtual ~EqualizerLogStreamBuf();
+        //! Identical messages are logged at most maxRepeats times every 
+        //! intervalMs milliseconds. The number of suppressed messages is 
+        //! logged when the interval ends. maxRepeats = 0 disables the limit.
+        void setRateLimit(int maxRepeats, int intervalMs);
     protected:
-        virtual int overflow ( int c = EOF )
-        {
-            if(c == '\n')
-            {
-                omsg(myStringStream.str().c_str());
-                myStringStream.str(""); 
-            }
-            else
-            {
-                myStringStream << (char)c;
-            }
-            return 0;
-        }
+        virtual int overflow ( int c = EOF );
+        virtual std::streamsize xsputn(const char* s, std::streamsize n);
     private:
-        std::ostringstream myStringStream;
+        LogSink* mySink;
     };
 
     ///////////////////////////////////////////////////////////////////////////////////////////////
@@ -90,12 +119,145 @@ namespace omega
         //! @internal Finish equalizer display system initialization.
         //! This method is called from the node init function. Performs observer initialization.
         void finishInitialize(ConfigImpl* config, Engine* engine);
+        //! @internal Called when the Equalizer configuration is created, 
+        //! before any module is initialized.
+        void setConfig(ConfigImpl* config) { myConfig = config; }
 
         void exitConfig();
 
+        //! Requests a new frame. Only needed when the display system runs in
+        //! on-demand redraw mode (redrawMode = "onDemand"), and the application
+        //! changes what is displayed without input events or shared data 
+        //! changes (i.e. a timer or a background load completing). Can be 
+        //! called from any thread on the master node.
+        void requestRedraw();
+
+        //! Time of the current frame, in seconds. Same as the update context
+        //! time (the sum of all frame time steps) in double precision: the
+        //! update context stores it as a float, which loses precision over
+        //! long sessions. Available on all nodes.
+        double getFrameTime();
+
+        //! True while replaying a shared data recording or an input capture.
+        //! Replay runs on the master node, so SystemManager::isMaster() is 
+        //! true: modules that only produce shared state on the master (input
+        //! handling, simulation, scripts driving the scene) should check this
+        //! and act as on a slave, or their changes mix with the replayed 
+        //! data.
+        bool isReplaying();
+
+        //! Frame export
+        //@{
+        bool isFrameExportEnabled() { return myFrameExporter != NULL; }
+        int getFrameExportBuffers() { return myFrameExportBuffers; }
+        void addFrameExportListener(FrameExportListener* listener);
+        void removeFrameExportListener(FrameExportListener* listener);
+        //! @internal
+        FrameExporter* getFrameExporter() { return myFrameExporter; }
+        //@}
+
+        //! Progressive transfers
+        //! Sends a large payload from the master to all nodes in chunks, 
+        //! spread over multiple frames so that interactive frames keep their 
+        //! rate. At most sharedStreamBudget bytes (display configuration, 
+        //! default 1MB) are sent each frame for all transfers. The data is 
+        //! copied. Sending again with the id of a transfer in progress 
+        //! restarts it. Nodes joining during a transfer do not receive it.
+        //@{
+        void sendSharedStream(const String& streamId, const void* data, uint64 size);
+        void addSharedStreamListener(SharedStreamListener* listener);
+        void removeSharedStreamListener(SharedStreamListener* listener);
+        //@}
+
+        //! Shared data lanes
+        //! When sharedDataBulkLane is enabled in the display configuration, 
+        //! shared objects declared as bulk (here or in the bulkSharedObjects 
+        //! list) travel in a separate stream. Slaves wait for the priority 
+        //! lane (update context, events, camera and observer updates) every
+        //! frame, and apply whatever bulk data arrived without waiting for 
+        //! it, so a large bulk update does not delay input. The master 
+        //! commits the bulk lane after the frame started, so it overlaps 
+        //! rendering, but its serialization still runs on the master thread:
+        //! large data that changes rarely is better sent as a progressive 
+        //! transfer, which uses the bulk lane and a per-frame byte budget 
+        //! (sharedStreamBudget). The lane needs to be declared on all nodes 
+        //! before the object is registered.
+        void setSharedObjectLane(const String& objectId, bool bulk);
+
+        //! Interest filtering
+        //! When sharedDataInterest is enabled in the display configuration,
+        //! a shared object can be limited to the nodes that use it: names 
+        //! are tile names or node hostnames. The object is only sent to and 
+        //! registered on those nodes (and the master). Interest sets can 
+        //! also be listed in the sharedObjectInterest display setting, i.e.
+        //! sharedObjectInterest: { leftOverlay = ["t0x0", "t0x1"]; };
+        //! The interest set needs to be declared on all nodes before the 
+        //! object is registered.
+        void setSharedObjectInterest(const String& objectId, const Vector<String>& names);
+        //! @internal Returns the key identifying a node in interest sets.
+        String getNodeKey(const DisplayNodeConfig& nc);
+
+        //! Relay tree
+        //! When sharedDataRelayFanout is set to a value > 0 in the display 
+        //! configuration, the master sends the shared data to that many 
+        //! nodes only. Each of them forwards every version to up to fanout
+        //! nodes, and so on. Nodes are placed in the tree in configuration 
+        //! order. The tree is fixed: it does not follow hot reconfiguration.
+        //@{
+        bool isRelayEnabled() { return myRelayFanout > 0; }
+        //! @internal Returns the key of the node the given node receives the
+        //! shared data from, or an empty string for the master.
+        String getRelayParent(const String& nodeKey);
+        //! @internal Returns true if other nodes receive the shared data
+        //! through the given node.
+        bool hasRelayChildren(const String& nodeKey);
+        //@}
+
+        //! @internal Returns the thread placement policy, or NULL when 
+        //! threads are left to the OS scheduler (threadAffinity = "none").
+        ThreadAffinity* getThreadAffinity() { return myThreadAffinity; }
+
+        //! Hot reconfiguration
+        //! When hotReconfiguration is enabled in the display configuration,
+        //! each tile is attached to its own Equalizer canvas, and tiles 
+        //! (and with them, pipes and nodes) can be deactivated and 
+        //! reactivated while the application runs: resources left without
+        //! active tiles are shut down, and nodes coming back up map the 
+        //! shared data again. Nodes listed in standbyNodes are launched but 
+        //! start inactive. The node and pipe set itself is fixed when the
+        //! configuration is generated. Can be called from any thread on the
+        //! master node: changes are applied before the next frame.
+        //@{
+        bool isHotReconfigurationEnabled() { return myHotReconfiguration; }
+        void setTileActive(const String& tileName, bool active);
+        void setNodeActive(const String& hostname, bool active);
+        //! Restarts a node (i.e. after its process crashed) without stopping
+        //! the rest of the cluster: the node is deactivated, launched again 
+        //! and reactivated after the launcher interval. When it starts, it 
+        //! receives a snapshot of all shared objects and then joins the 
+        //! per-frame updates.
+        void rejoinNode(const String& hostname);
+        //@}
+
+        //! @internal Returns the display section of the system configuration,
+        //! where Equalizer-specific options are stored, or NULL if missing.
+        Setting* getDisplaySettings();
+
+        //! @internal Generates the Equalizer configuration for the current 
+        //! display configuration, writes it to the configuration file unless
+        //! the config generator is disabled, and returns it.
+        String generateEqConfig();
+
     private:
-        void generateEqConfig();
+        void readDisplayOptions();
+        void applyTileActivation();
+        void updateNodeRejoin();
+        void launchNode(DisplayNodeConfig& nc);
+        void buildRelayTree();
         void setupEqInitArgs(int& numArgs, const char** argv);
+        //! Returns true if the node shares its host with the master or with
+        //! another enabled node.
+        bool hasLocalPeers(const DisplayNodeConfig& nc);
         String buildTileConfig(String& indent, const String tileName, int x, int y, int width, int height, int port, int device, int curdevice, bool fullscreen, bool borderless, bool offscreen);
 
     private:
@@ -105,6 +267,38 @@ namespace omega
         EqualizerNodeFactory* myNodeFactory;
         ConfigImpl* myConfig;
 
+        // Master loop frame pacing
+        FramePacer* myFramePacer;
+
+        // Frame export
+        FrameExporter* myFrameExporter;
+        int myFrameExportBuffers;
+
+        // Hot reconfiguration
+        bool myHotReconfiguration;
+        Vector<String> myStandbyNodes;
+        omicron::Lock myTileActivationLock;
+        List< std::pair<String, bool> > myTileActivation;
+        List<String> myNodesToLaunch;
+        // Launch time (FrameClock::now) of nodes waiting to be reactivated
+        Dictionary<String, uint64_t> myLaunchedNodes;
+
+        ThreadAffinity* myThreadAffinity;
+
+        // Relay tree: node key -> parent node key (empty for the master)
+        int myRelayFanout;
+        Dictionary<String, String> myRelayParents;
+
+        // Named pipes for same-host nodes (namedPipeTransport, windows)
+        bool myNamedPipeTransport;
+        // Listen arguments passed to Equalizer: must outlive eq::init.
+        String myTcpListenArg;
+        String myPipeListenArg;
+
+        // Equalizer log routing
+        EqualizerLogStreamBuf* myLogStreamBuf;
+        std::ostream* myLogStream;
+
         // Debug
         bool myDebugMouse;
     };
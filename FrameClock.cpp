@@ -0,0 +1,152 @@
+/******************************************************************************
+ * THE OMEGA LIB PROJECT
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2016		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2016, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file
+ *	The master frame clock: a 64-bit monotonic clock producing the time and 
+ *  (optionally smoothed or fixed) time step broadcast to all nodes.
+ ******************************************************************************/
+#include "eqinternal.h"
+
+#ifdef OMEGA_OS_WIN
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+using namespace omega;
+using namespace co::base;
+using namespace std;
+
+// Raw time steps longer than this (i.e. after a hitch or an idle period)
+// are clamped before filtering, so they don't make animations jump.
+#define FRAME_CLOCK_MAX_DT 0.25
+
+///////////////////////////////////////////////////////////////////////////////
+uint64_t FrameClock::now()
+{
+#ifdef OMEGA_OS_WIN
+    static LARGE_INTEGER frequency;
+    if(frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    // Split the conversion to avoid overflowing 64 bits.
+    uint64_t seconds = counter.QuadPart / frequency.QuadPart;
+    uint64_t remainder = counter.QuadPart % frequency.QuadPart;
+    return seconds * 1000000 + remainder * 1000000 / frequency.QuadPart;
+#elif defined(__APPLE__)
+    static mach_timebase_info_data_t timebase;
+    if(timebase.denom == 0) mach_timebase_info(&timebase);
+    return mach_absolute_time() * timebase.numer / timebase.denom / 1000;
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+FrameClock::FrameClock():
+    myFilter(FilterNone),
+    mySmoothing(0.1f),
+    myFixedTimestep(0)
+{
+    reset();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FrameClock::setup(Setting& s)
+{
+    String filter = Config::getStringValue("frameClockFilter", s, "none");
+    StringUtils::toLowerCase(filter);
+    if(filter == "ema") myFilter = FilterEma;
+    else if(filter == "median") myFilter = FilterMedian;
+    else if(filter != "none") ofwarn("FrameClock: unknown filter %1%, using none", %filter);
+
+    mySmoothing = Config::getFloatValue("frameClockSmoothing", s, 0.1f);
+    myFixedTimestep = Config::getFloatValue("fixedTimestep", s, 0);
+
+    if(myFixedTimestep > 0) ofmsg("FrameClock: fixed time step %1% s", %myFixedTimestep);
+    else if(myFilter != FilterNone) ofmsg("FrameClock: %1% time step filtering", %filter);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FrameClock::reset()
+{
+    myStartTime = now();
+    myLastTime = 0;
+    myTime = 0;
+    myDt = 0;
+    myRawDt = 0;
+    myFrames = 0;
+    myHistory.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FrameClock::tick()
+{
+    uint64_t t = now() - myStartTime;
+    myRawDt = myFrames == 0 ? 0 : (double)(t - myLastTime) / 1000000.0;
+    myLastTime = t;
+    myFrames++;
+
+    // Fixed time step: time is fully determined by the frame count.
+    if(myFixedTimestep > 0)
+    {
+        myDt = myFixedTimestep;
+        myTime = (double)(myFrames - 1) * myFixedTimestep;
+        return;
+    }
+
+    double dt = min(myRawDt, FRAME_CLOCK_MAX_DT);
+    if(myFilter == FilterEma)
+    {
+        myDt = myFrames <= 2 ? dt : myDt + mySmoothing * (dt - myDt);
+    }
+    else if(myFilter == FilterMedian)
+    {
+        myHistory.push_back(dt);
+        if(myHistory.size() > MedianWindow) myHistory.pop_front();
+        Vector<double> sorted(myHistory.begin(), myHistory.end());
+        sort(sorted.begin(), sorted.end());
+        myDt = sorted[sorted.size() / 2];
+    }
+    else
+    {
+        myDt = dt;
+    }
+
+    // Time advances by the filtered time step, so it is always the sum of 
+    // the time steps handed to the application. It is accumulated in double
+    // precision: it does not lose resolution after hours of uptime.
+    myTime += myDt;
+}
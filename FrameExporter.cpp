@@ -0,0 +1,140 @@
+/******************************************************************************
+ * THE OMEGA LIB PROJECT
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2016		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2016, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file
+ *	The frame exporter: delivers frames read back by the Equalizer channels
+ *  to the registered FrameExportListeners on a worker thread.
+ ******************************************************************************/
+#include "eqinternal.h"
+
+using namespace omega;
+using namespace co::base;
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+FrameExporter::FrameExporter(int maxQueuedFrames):
+    myNumListeners(0),
+    myMaxQueuedFrames(maxQueuedFrames),
+    myAllocatedFrames(0)
+{
+    StatsManager* sm = SystemManager::instance()->getStatsManager();
+    if(sm != NULL) myDroppedFramesStat = sm->createStat("frameExport dropped", StatsManager::Count1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+FrameExporter::~FrameExporter()
+{
+    ExportedFrame* f;
+    while(myQueue.tryPop(f)) delete f;
+    foreach(ExportedFrame* f, myFreeFrames) delete f;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FrameExporter::addListener(FrameExportListener* listener)
+{
+    myListenerLock.lock();
+    myListeners.push_back(listener);
+    myNumListeners = myListeners.size();
+    myListenerLock.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FrameExporter::removeListener(FrameExportListener* listener)
+{
+    myListenerLock.lock();
+    myListeners.remove(listener);
+    myNumListeners = myListeners.size();
+    myListenerLock.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+ExportedFrame* FrameExporter::acquireFrame()
+{
+    ExportedFrame* frame = NULL;
+    myFreeLock.lock();
+    if(!myFreeFrames.empty())
+    {
+        frame = myFreeFrames.front();
+        myFreeFrames.pop_front();
+    }
+    else if(myAllocatedFrames < myMaxQueuedFrames)
+    {
+        frame = new ExportedFrame();
+        myAllocatedFrames++;
+    }
+    myFreeLock.unlock();
+
+    // All frames are queued or being exported: listeners are falling behind.
+    if(frame == NULL && myDroppedFramesStat != NULL) myDroppedFramesStat->addSample(1);
+    return frame;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FrameExporter::submitFrame(ExportedFrame* frame)
+{
+    myQueue.push(frame);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FrameExporter::releaseFrame(ExportedFrame* frame)
+{
+    myFreeLock.lock();
+    myFreeFrames.push_back(frame);
+    myFreeLock.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FrameExporter::shutdown()
+{
+    myQueue.push(NULL);
+    join();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FrameExporter::run()
+{
+    while(true)
+    {
+        // Blocks until a frame is submitted.
+        ExportedFrame* frame = myQueue.pop();
+        if(frame == NULL) break;
+
+        myListenerLock.lock();
+        foreach(FrameExportListener* l, myListeners)
+        {
+            l->onFrameExported(frame->channelName, frame->frameNum, 
+                frame->width, frame->height, &frame->pixels[0]);
+        }
+        myListenerLock.unlock();
+
+        releaseFrame(frame);
+    }
+}
@@ -0,0 +1,154 @@
+/******************************************************************************
+ * THE OMEGA LIB PROJECT
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2016		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2016, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file
+ *	The frame pacer: caps the master frame rate, skips idle frames (or only
+ *  draws on demand) and keeps frame interval / jitter statistics.
+ ******************************************************************************/
+#include "eqinternal.h"
+
+using namespace omega;
+using namespace co::base;
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+FramePacer::FramePacer():
+    myMaxFps(0),
+    myIdleFrameSkip(false),
+    myIdleFrameInterval(1.0f),
+    myRedrawMode(RedrawContinuous),
+    myPollInterval(5),
+    // The first frame always runs.
+    myRedrawRequested(true),
+    myLastFrameStart(0),
+    myLastInterval(0)
+{
+    myTimer.start();
+
+    StatsManager* sm = SystemManager::instance()->getStatsManager();
+    myIntervalStat = sm->createStat("frame interval", StatsManager::Time);
+    myJitterStat = sm->createStat("frame jitter", StatsManager::Time);
+    mySkippedFramesStat = sm->createStat("frames skipped", StatsManager::Count1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FramePacer::setup(Setting& s)
+{
+    myMaxFps = Config::getFloatValue("maxFps", s, 0);
+    myIdleFrameSkip = Config::getBoolValue("idleFrameSkip", s, false);
+    myIdleFrameInterval = Config::getFloatValue("idleFrameInterval", s, 1.0f);
+    myPollInterval = Config::getIntValue("onDemandPollInterval", s, 5);
+
+    String redrawMode = Config::getStringValue("redrawMode", s, "continuous");
+    StringUtils::toLowerCase(redrawMode);
+    if(redrawMode == "ondemand") myRedrawMode = RedrawOnDemand;
+    else if(redrawMode != "continuous") ofwarn("FramePacer: unknown redraw mode %1%, using continuous", %redrawMode);
+
+    if(myMaxFps > 0) ofmsg("FramePacer: frame rate capped at %1% fps", %myMaxFps);
+    if(myRedrawMode == RedrawOnDemand) omsg("FramePacer: on-demand redraw mode");
+    else if(myIdleFrameSkip) ofmsg("FramePacer: idle frame skipping enabled (interval %1% s)", %myIdleFrameInterval);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FramePacer::requestRedraw()
+{
+    myRedrawLock.lock();
+    myRedrawRequested = true;
+    myRedrawLock.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool FramePacer::waitForFrame(ConfigImpl* config)
+{
+    double now = myTimer.getElapsedTimeInMilliSec();
+
+    // Frame rate cap: sleep until the next frame is due. We sleep for most 
+    // of the remaining time and yield for the last millisecond, since sleep 
+    // granularity is too coarse to hit the target interval reliably.
+    if(myMaxFps > 0)
+    {
+        double nextFrame = myLastFrameStart + 1000.0 / myMaxFps;
+        if(nextFrame - now > 2.0) osleep((uint)(nextFrame - now - 1.0));
+        while(myTimer.getElapsedTimeInMilliSec() < nextFrame) osleep(0);
+    }
+
+    if(isIdleFrameSkipEnabled())
+    {
+        myRedrawLock.lock();
+        bool redrawRequested = myRedrawRequested;
+        myRedrawRequested = false;
+        myRedrawLock.unlock();
+
+        SharedData* sd = config->getSharedData();
+        // An exit request counts as an event: the master loop needs to run
+        // the final frames.
+        bool redraw = config->pollEvents() || 
+            sd->hasChanged() ||
+            redrawRequested ||
+            SystemManager::instance()->isExitRequested();
+
+        // When skipping idle frames in continuous mode, we still run one
+        // frame every idle interval.
+        if(myRedrawMode == RedrawContinuous)
+        {
+            double sinceLastFrame = myTimer.getElapsedTimeInMilliSec() - myLastFrameStart;
+            if(sinceLastFrame >= myIdleFrameInterval * 1000.0) redraw = true;
+        }
+
+        if(!redraw)
+        {
+            mySkippedFramesStat->addSample(1);
+            // The next interval will include the idle time: don't count it
+            // as jitter.
+            myLastInterval = 0;
+            // Don't spin: we are idle, so a few ms of extra latency on the
+            // next input event are fine.
+            osleep(myRedrawMode == RedrawOnDemand ? myPollInterval : 2);
+            return false;
+        }
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FramePacer::frameStarted()
+{
+    double now = myTimer.getElapsedTimeInMilliSec();
+    if(myLastFrameStart > 0)
+    {
+        double interval = now - myLastFrameStart;
+        myIntervalStat->addSample(interval);
+        // Jitter is the change in frame interval between consecutive frames.
+        if(myLastInterval > 0) myJitterStat->addSample(fabs(interval - myLastInterval));
+        myLastInterval = interval;
+    }
+    myLastFrameStart = now;
+}
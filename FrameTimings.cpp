@@ -0,0 +1,138 @@
+/******************************************************************************
+ * THE OMEGA LIB PROJECT
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2016		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2016, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file
+ *	Per-node aggregation of the window draw, barrier wait and swap times.
+ ******************************************************************************/
+#include "eqinternal.h"
+#include "EqualizerDisplaySystem.h"
+
+using namespace omega;
+using namespace co::base;
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+FrameTimings::FrameTimings():
+    myEnabled(false),
+    myFrame(0),
+    myWindows(0),
+    myDraw(0),
+    myWait(0),
+    mySwap(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FrameTimings::setup(Setting& s)
+{
+    myEnabled = Config::getBoolValue("frameTimingStats", s, false);
+
+    if(!myEnabled) return;
+
+    // Stats are created here, on the node main thread: timings are reported
+    // by the pipe threads.
+    SystemManager* sys = SystemManager::instance();
+    StatsManager* sm = sys->getStatsManager();
+    if(sm == NULL)
+    {
+        owarn("FrameTimings: no stats manager, frame timing stats disabled");
+        myEnabled = false;
+        return;
+    }
+    myDrawStat = sm->createStat("node draw", StatsManager::Time);
+    myWaitStat = sm->createStat("node barrier wait", StatsManager::Time);
+    mySwapStat = sm->createStat("node swap", StatsManager::Time);
+
+    // Window stats, for the tiles of this node. Windows are named after 
+    // their tile.
+    EqualizerDisplaySystem* eqds = (EqualizerDisplaySystem*)sys->getDisplaySystem();
+    typedef KeyValue<String, Ref<DisplayTileConfig> > TileItem;
+    foreach(TileItem tile, eqds->getDisplayConfig().tiles)
+    {
+        DisplayNodeConfig* nc = tile->node;
+        if(nc == NULL || !tile->enabled) continue;
+        bool local = sys->isMaster() ? !nc->isRemote : 
+            eqds->getNodeKey(*nc) == sys->getHostnameAndPort();
+        if(!local) continue;
+        WindowStats& ws = myWindowStats[tile->name];
+        ws.draw = sm->createStat(tile->name + " draw", StatsManager::Time);
+        ws.wait = sm->createStat(tile->name + " barrier wait", StatsManager::Time);
+        ws.swap = sm->createStat(tile->name + " swap", StatsManager::Time);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FrameTimings::addWindowFrame(const String& window, uint32_t frameNumber, uint64_t draw, uint64_t wait, uint64_t swap)
+{
+    // The window stats map does not change after setup.
+    Dictionary<String, WindowStats>::iterator it = myWindowStats.find(window);
+    if(it != myWindowStats.end())
+    {
+        it->second.draw->addSample((double)draw / 1000.0);
+        it->second.wait->addSample((double)wait / 1000.0);
+        it->second.swap->addSample((double)swap / 1000.0);
+    }
+
+    myLock.lock();
+    // Windows of a node run the same frame, but pipe threads may already 
+    // report the next one: a new frame number completes the previous frame.
+    // Reports arriving after that are dropped.
+    if(myWindows > 0 && frameNumber < myFrame)
+    {
+        myLock.unlock();
+        return;
+    }
+    if(myWindows > 0 && frameNumber != myFrame) flush();
+    if(myWindows == 0)
+    {
+        myFrame = frameNumber;
+        myDraw = draw;
+        myWait = wait;
+        mySwap = swap;
+    }
+    else
+    {
+        myDraw = max(myDraw, draw);
+        myWait = min(myWait, wait);
+        mySwap = max(mySwap, swap);
+    }
+    myWindows++;
+    myLock.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FrameTimings::flush()
+{
+    myDrawStat->addSample((double)myDraw / 1000.0);
+    myWaitStat->addSample((double)myWait / 1000.0);
+    mySwapStat->addSample((double)mySwap / 1000.0);
+    myWindows = 0;
+}
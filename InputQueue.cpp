@@ -0,0 +1,110 @@
+/******************************************************************************
+ * THE OMEGA LIB PROJECT
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2016		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2016, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file
+ *	A fixed-size queue of compact input records, filled by the Equalizer 
+ *  window event handlers and drained once per frame by the master.
+ ******************************************************************************/
+#include "eqinternal.h"
+
+using namespace omega;
+using namespace co::base;
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+InputQueue::InputQueue():
+    myHead(0),
+    myCount(0),
+    myCoalesceMotion(false)
+{
+    myRecords.resize(256);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void InputQueue::setup(Setting& s)
+{
+    int length = Config::getIntValue("inputQueueLength", s, myRecords.size());
+    myRecords.resize(max(length, 1));
+    myHead = 0;
+    myCount = 0;
+    myCoalesceMotion = Config::getBoolValue("coalescePointerMotion", s, myCoalesceMotion);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void InputQueue::push(const InputRecord& r)
+{
+    myLock.lock();
+    int capacity = myRecords.size();
+    if(myCoalesceMotion && myCount > 0 && r.kind == InputRecord::PointerMotion)
+    {
+        InputRecord& last = myRecords[(myHead + myCount - 1) % capacity];
+        if(last.kind == InputRecord::PointerMotion && last.eventIndex == r.eventIndex)
+        {
+            uint64_t time = last.time;
+            last = r;
+            last.time = time;
+            myLock.unlock();
+            return;
+        }
+    }
+
+    if(myCount < capacity)
+    {
+        myRecords[(myHead + myCount) % capacity] = r;
+        myCount++;
+    }
+    else
+    {
+        if(myDroppedStat == NULL)
+        {
+            StatsManager* sm = SystemManager::instance()->getStatsManager();
+            if(sm != NULL) myDroppedStat = sm->createStat("input records dropped", StatsManager::Count1);
+        }
+        if(myDroppedStat != NULL) myDroppedStat->addSample(1);
+    }
+    myLock.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool InputQueue::pop(InputRecord& r)
+{
+    myLock.lock();
+    if(myCount == 0)
+    {
+        myLock.unlock();
+        return false;
+    }
+    r = myRecords[myHead];
+    myHead = (myHead + 1) % myRecords.size();
+    myCount--;
+    myLock.unlock();
+    return true;
+}
@@ -0,0 +1,132 @@
+/******************************************************************************
+ * THE OMEGA LIB PROJECT
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2016		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2016, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file
+ *	A thread-safe latency histogram, used to track input-to-display latency
+ *  on each node.
+ ******************************************************************************/
+#include "eqinternal.h"
+
+using namespace omega;
+using namespace co::base;
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+LatencyHistogram::LatencyHistogram(const String& name):
+    myName(name),
+    myBucketWidth(10),
+    myReportInterval(0),
+    mySamples(0),
+    myTotal(0),
+    myMax(0),
+    myAverage(0)
+{
+    memset(myBuckets, 0, sizeof(myBuckets));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void LatencyHistogram::setup(Setting& s)
+{
+    myBucketWidth = Config::getFloatValue("inputLatencyBucket", s, myBucketWidth);
+    if(myBucketWidth <= 0) myBucketWidth = 10;
+    myReportInterval = Config::getIntValue("inputLatencyReportInterval", s, myReportInterval);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void LatencyHistogram::addSample(uint64_t latencyUs)
+{
+    myLock.lock();
+
+    // Stats are created lazily, since the stats manager may not exist yet
+    // when the histogram is set up.
+    if(myStat == NULL)
+    {
+        StatsManager* sm = SystemManager::instance()->getStatsManager();
+        if(sm != NULL) myStat = sm->createStat(myName, StatsManager::Time);
+    }
+
+    double ms = (double)latencyUs / 1000.0;
+    if(myStat != NULL) myStat->addSample(ms);
+
+    int bucket = (int)(ms / myBucketWidth);
+    if(bucket >= NumBuckets) bucket = NumBuckets - 1;
+    myBuckets[bucket]++;
+    mySamples++;
+    myTotal += latencyUs;
+    if(latencyUs > myMax) myMax = latencyUs;
+    myAverage = myAverage == 0 ? latencyUs : myAverage * 0.9 + latencyUs * 0.1;
+
+    if(myReportInterval > 0 && mySamples >= (uint64_t)myReportInterval)
+    {
+        report();
+    }
+
+    myLock.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+double LatencyHistogram::getAverage()
+{
+    myLock.lock();
+    double avg = myAverage;
+    myLock.unlock();
+    return avg;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+String LatencyHistogram::toString()
+{
+    String res = ostr("%1%: %2% samples, avg %3% ms, max %4% ms\n",
+        %myName %mySamples 
+        %(mySamples > 0 ? (double)myTotal / mySamples / 1000.0 : 0.0)
+        %((double)myMax / 1000.0));
+    for(int i = 0; i < NumBuckets; i++)
+    {
+        float low = i * myBucketWidth;
+        String range = i < NumBuckets - 1 ?
+            ostr("%1%-%2% ms", %low %(low + myBucketWidth)) :
+            ostr(">%1% ms", %low);
+        int percent = mySamples > 0 ? (int)(myBuckets[i] * 100 / mySamples) : 0;
+        res += ostr("    %1%\t%2%\t%3%%% %4%\n", 
+            %range %myBuckets[i] %percent %String(percent / 2, '#'));
+    }
+    return res;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void LatencyHistogram::report()
+{
+    omsg(toString());
+    memset(myBuckets, 0, sizeof(myBuckets));
+    mySamples = 0;
+    myTotal = 0;
+    myMax = 0;
+}
@@ -0,0 +1,266 @@
+/******************************************************************************
+ * THE OMEGA LIB PROJECT
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2016		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2016, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file
+ *	Asynchronous, rate-limited routing of the Equalizer log into the omega 
+ *  log.
+ ******************************************************************************/
+#include "eqinternal.h"
+
+#ifdef OMEGA_OS_WIN
+#include <windows.h>
+#define LOG_INCREMENT(ptr) InterlockedIncrement((LONG volatile*)(ptr))
+#else
+#include <pthread.h>
+#define LOG_INCREMENT(ptr) __sync_add_and_fetch((ptr), 1)
+#endif
+
+using namespace omega;
+using namespace co::base;
+using namespace std;
+
+// Lines longer than this are split, so a writer that never ends its line 
+// does not grow its buffer forever.
+#define LOG_SINK_MAX_LINE 4096
+
+// Per-thread line being assembled and thread tag. Allocated on the first 
+// write from each thread and deleted when the thread exits.
+struct LogThreadState
+{
+    int id;
+    String line;
+};
+volatile long sLogThreadCount = 0;
+
+#ifdef OMEGA_OS_WIN
+VOID WINAPI deleteLogThreadState(PVOID state)
+{
+    delete (LogThreadState*)state;
+}
+DWORD sLogThreadKey = FlsAlloc(deleteLogThreadState);
+#define LOG_GET_STATE() ((LogThreadState*)FlsGetValue(sLogThreadKey))
+#define LOG_SET_STATE(state) FlsSetValue(sLogThreadKey, (state))
+#else
+void deleteLogThreadState(void* state)
+{
+    delete (LogThreadState*)state;
+}
+pthread_key_t createLogThreadKey()
+{
+    pthread_key_t key;
+    pthread_key_create(&key, deleteLogThreadState);
+    return key;
+}
+pthread_key_t sLogThreadKey = createLogThreadKey();
+#define LOG_GET_STATE() ((LogThreadState*)pthread_getspecific(sLogThreadKey))
+#define LOG_SET_STATE(state) pthread_setspecific(sLogThreadKey, (state))
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+EqualizerLogStreamBuf::EqualizerLogStreamBuf()
+{
+    mySink = new LogSink();
+    mySink->start();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+EqualizerLogStreamBuf::~EqualizerLogStreamBuf()
+{
+    delete mySink;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EqualizerLogStreamBuf::setRateLimit(int maxRepeats, int intervalMs)
+{
+    mySink->setRateLimit(maxRepeats, intervalMs);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int EqualizerLogStreamBuf::overflow(int c)
+{
+    if(c != EOF)
+    {
+        char ch = (char)c;
+        mySink->write(&ch, 1);
+    }
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::streamsize EqualizerLogStreamBuf::xsputn(const char* s, std::streamsize n)
+{
+    mySink->write(s, n);
+    return n;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+LogSink::LogSink():
+    myMaxRepeats(5),
+    myRateInterval(1000)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+LogSink::~LogSink()
+{
+    myQueue.push(NULL);
+    join();
+    // Anything pushed after the thread exited.
+    Record* r;
+    while(myQueue.tryPop(r))
+    {
+        if(r == NULL) continue;
+        process(r);
+        delete r;
+    }
+    expireRepeats(true);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void LogSink::setRateLimit(int maxRepeats, int intervalMs)
+{
+    myMaxRepeats = maxRepeats;
+    myRateInterval = intervalMs;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void LogSink::write(const char* data, size_t size)
+{
+    LogThreadState* state = LOG_GET_STATE();
+    if(state == NULL)
+    {
+        state = new LogThreadState();
+        state->id = LOG_INCREMENT(&sLogThreadCount);
+        LOG_SET_STATE(state);
+    }
+
+    // Complete lines are handed to the sink thread. Whatever follows the 
+    // last newline stays in the thread buffer.
+    const char* end = data + size;
+    while(data < end)
+    {
+        const char* nl = (const char*)memchr(data, '\n', end - data);
+        const char* lineEnd = nl != NULL ? nl : end;
+        state->line.append(data, lineEnd - data);
+        if(nl != NULL || state->line.size() >= LOG_SINK_MAX_LINE)
+        {
+            if(!state->line.empty())
+            {
+                Record* r = new Record();
+                r->thread = state->id;
+                r->text.swap(state->line);
+                myQueue.push(r);
+            }
+            state->line.clear();
+        }
+        data = nl != NULL ? nl + 1 : end;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void LogSink::run()
+{
+    // The sink sleeps until a message arrives. Repeats are expired when 
+    // messages are processed, so the suppressed count of a message is 
+    // reported with the next message after its window ends (or on exit).
+    uint64_t lastExpire = FrameClock::now();
+    while(true)
+    {
+        Record* r = myQueue.pop();
+        if(r == NULL) break;
+        process(r);
+        delete r;
+
+        uint64_t now = FrameClock::now();
+        if(now - lastExpire > 1000000)
+        {
+            expireRepeats(false);
+            lastExpire = now;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void LogSink::process(Record* r)
+{
+    if(myMaxRepeats <= 0)
+    {
+        ofmsg("[eq:%1%] %2%", %r->thread %r->text);
+        return;
+    }
+
+    uint64_t now = FrameClock::now();
+    Dictionary<String, RepeatInfo>::iterator it = myRepeats.find(r->text);
+    if(it == myRepeats.end())
+    {
+        RepeatInfo ri;
+        ri.windowStart = now;
+        ri.count = 0;
+        ri.suppressed = 0;
+        it = myRepeats.insert(pair<String, RepeatInfo>(r->text, ri)).first;
+    }
+    RepeatInfo& ri = it->second;
+    if(now - ri.windowStart > (uint64_t)myRateInterval * 1000)
+    {
+        if(ri.suppressed > 0)
+        {
+            ofmsg("[eq] (%1% repeats suppressed) %2%", %ri.suppressed %r->text);
+        }
+        ri.windowStart = now;
+        ri.count = 0;
+        ri.suppressed = 0;
+    }
+
+    if(++ri.count <= myMaxRepeats) ofmsg("[eq:%1%] %2%", %r->thread %r->text);
+    else ri.suppressed++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void LogSink::expireRepeats(bool all)
+{
+    // Drop messages whose rate window has ended, so the table does not grow
+    // with every distinct message, reporting the suppressed count first.
+    uint64_t now = FrameClock::now();
+    List<String> expired;
+    typedef Dictionary<String, RepeatInfo>::Item RepeatItem;
+    foreach(RepeatItem item, myRepeats)
+    {
+        if(all || now - item.second.windowStart > (uint64_t)myRateInterval * 1000)
+        {
+            if(item.second.suppressed > 0)
+            {
+                ofmsg("[eq] (%1% repeats suppressed) %2%", %item.second.suppressed %item.getKey());
+            }
+            expired.push_back(item.getKey());
+        }
+    }
+    foreach(String key, expired) myRepeats.erase(key);
+}
@@ -54,11 +54,28 @@ bool NodeImpl::configInit( const eq::uint128_t& initID )
 	//ofmsg("[EQ] NodeImpl::configInit %1%", %initID);
 
 	SystemManager* sys = SystemManager::instance();
+	EqualizerDisplaySystem* ds = (EqualizerDisplaySystem*)sys->getDisplaySystem();
+	if(ds->getThreadAffinity() != NULL)
+	{
+		// The node thread runs Engine::update: keep it close to the first 
+		// GPU of this node.
+		int device = 0;
+		const eq::Pipes& pipes = getPipes();
+		if(!pipes.empty() && pipes[0]->getDevice() != EQ_UNDEFINED_UINT32)
+		{
+			device = pipes[0]->getDevice();
+		}
+		ds->getThreadAffinity()->pinNodeThread(device);
+	}
+
 	if(!sys->isMaster())
 	{
 		ConfigImpl* config = static_cast<ConfigImpl*>( getConfig());
 		config->mapSharedData(initID);
 
+		// A node started again after a hot reconfiguration gets a new 
+		// engine: the previous one was disposed in configExit.
+		if(myServer == NULL) myServer = new Engine(sys->getApplication());
 		myServer->initialize();
 		
 		EqualizerDisplaySystem* eqds = (EqualizerDisplaySystem*)SystemManager::instance()->getDisplaySystem();
@@ -76,7 +93,14 @@ bool NodeImpl::configExit()
 	SystemManager* sys = SystemManager::instance();
 	if(!sys->isMaster())
 	{
+		// Deferred shared object updates may still be running on worker
+		// threads: let them complete before the objects go away.
+		ConfigImpl* config = static_cast<ConfigImpl*>(getConfig());
+		config->finishSharedDataApply();
 		myServer->dispose();
+		myServer = NULL;
+		// With hot reconfiguration the node may be started again later.
+		config->unmapSharedData();
 	}
 	return Node::configExit();
 }
@@ -93,6 +117,7 @@ void NodeImpl::frameStart( const eq::uint128_t& frameID, const uint32_t frameNum
 
 		const UpdateContext& uc = config->getUpdateContext();
 		myServer->update(uc);
+		config->checkFrameState();
 	}
 
 	if(!getClient()->isConnected()) getClient()->exitLocal();
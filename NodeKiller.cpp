@@ -0,0 +1,167 @@
+/******************************************************************************
+ * THE OMEGA LIB PROJECT
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2016		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2016, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file
+ *	Confirmed shutdown of remote application instances, used by 
+ *  EqualizerDisplaySystem::killCluster.
+ ******************************************************************************/
+#include "eqinternal.h"
+
+#include <stdlib.h>
+#ifndef OMEGA_OS_WIN
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+using namespace omega;
+using namespace co::base;
+using namespace std;
+
+// Interval between liveness checks, in milliseconds.
+#define NODE_KILLER_POLL_INTERVAL 200
+// Maximum time a single port probe can take, in microseconds.
+#define NODE_KILLER_CONNECT_TIMEOUT 300000
+
+///////////////////////////////////////////////////////////////////////////////
+NodeKiller::NodeKiller(const Options& opts, const String& procName, const String& hostname, int port):
+    myOptions(opts),
+    myProcName(procName),
+    myHostname(hostname),
+    myPort(port),
+    myDone(false),
+    myConfirmed(false),
+    myStopRequested(false)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+String NodeKiller::expand(const String& command)
+{
+    String cmd = StringUtils::replaceAll(command, "%c", myProcName);
+    return StringUtils::replaceAll(cmd, "%h", myHostname);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void NodeKiller::run()
+{
+    // Kill commands are launched like any other omegalib command, without 
+    // waiting for them: polling tells us when the node is down.
+    if(myOptions.killCommand != "") olaunch(expand(myOptions.killCommand));
+    myConfirmed = waitForExit();
+
+    if(!myConfirmed && !myStopRequested && myOptions.escalationCommand != "")
+    {
+        ofwarn("NodeKiller: %1% still running after %2% s, escalating", 
+            %myHostname %myOptions.timeout);
+        olaunch(expand(myOptions.escalationCommand));
+        myConfirmed = waitForExit();
+    }
+
+    if(!myConfirmed) ofwarn("NodeKiller: could not confirm %1% exited", %myHostname);
+    myDone = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool NodeKiller::waitForExit()
+{
+    Timer timer;
+    timer.start();
+    while(timer.getElapsedTimeInMilliSec() < myOptions.timeout * 1000 && !myStopRequested)
+    {
+        if(!isAlive()) return true;
+        osleep(NODE_KILLER_POLL_INTERVAL);
+    }
+    return !isAlive();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool NodeKiller::isAlive()
+{
+    if(isPortOpen()) return true;
+    // The check command is expected to succeed (return 0) while the process
+    // is running, like 'ssh %h pgrep -x %c'. We need its exit status, so it
+    // runs synchronously: it should time out on its own (i.e. ssh -o 
+    // ConnectTimeout=2) so an unreachable host does not hang this thread.
+    if(myOptions.checkCommand != "") return system(expand(myOptions.checkCommand).c_str()) == 0;
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool NodeKiller::isPortOpen()
+{
+#ifdef OMEGA_OS_WIN
+    // Port probing is not implemented on windows: rely on the check command.
+    return false;
+#else
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = NULL;
+    String port = ostr("%1%", %myPort);
+    if(getaddrinfo(myHostname.c_str(), port.c_str(), &hints, &addresses) != 0) return false;
+
+    bool open = false;
+    for(addrinfo* ai = addresses; ai != NULL && !open; ai = ai->ai_next)
+    {
+        int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if(fd < 0) continue;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        if(connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+        {
+            open = true;
+        }
+        else if(errno == EINPROGRESS)
+        {
+            fd_set fds;
+            FD_ZERO(&fds);
+            FD_SET(fd, &fds);
+            timeval tv;
+            tv.tv_sec = 0;
+            tv.tv_usec = NODE_KILLER_CONNECT_TIMEOUT;
+            if(select(fd + 1, NULL, &fds, NULL, &tv) > 0)
+            {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                open = (err == 0);
+            }
+        }
+        close(fd);
+    }
+    freeaddrinfo(addresses);
+    return open;
+#endif
+}
@@ -0,0 +1,209 @@
+/******************************************************************************
+ * THE OMEGA LIB PROJECT
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2016		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2016, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file
+ *	Constant-velocity prediction of tracker and pointer poses, used on the
+ *  master to compensate the latency between input and display.
+ ******************************************************************************/
+#include "eqinternal.h"
+
+using namespace omega;
+using namespace co::base;
+using namespace std;
+
+// Samples further apart than this (in seconds) reset the track velocity, so a
+// tracker that drops out and comes back does not get a huge velocity.
+#define POSE_PREDICTOR_MAX_SAMPLE_GAP 0.5
+// Maximum number of pending predictions kept per track for error tracking.
+#define POSE_PREDICTOR_MAX_PENDING 16
+
+///////////////////////////////////////////////////////////////////////////////
+PosePredictor::PosePredictor():
+    myEnabled(false),
+    myFixedHorizon(0),
+    myMaxHorizon(100),
+    mySmoothing(0.5f),
+    myMeasuredLatency(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+PosePredictor::~PosePredictor()
+{
+    typedef Dictionary<uint64_t, Track*>::Item TrackItem;
+    foreach(TrackItem t, myTracks) delete t.second;
+    myTracks.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void PosePredictor::setup(Setting& s)
+{
+    String mode = Config::getStringValue("posePrediction", s, "none");
+    StringUtils::toLowerCase(mode);
+    if(mode == "constantvelocity")
+    {
+        myEnabled = true;
+    }
+    else if(mode != "none")
+    {
+        ofwarn("PosePredictor: unknown posePrediction mode %1%, prediction disabled", %mode);
+    }
+
+    myFixedHorizon = Config::getFloatValue("posePredictionHorizon", s, myFixedHorizon);
+    myMaxHorizon = Config::getFloatValue("posePredictionMaxHorizon", s, myMaxHorizon);
+    mySmoothing = Config::getFloatValue("posePredictionSmoothing", s, mySmoothing);
+    if(mySmoothing < 0) mySmoothing = 0;
+    if(mySmoothing > 0.99f) mySmoothing = 0.99f;
+
+    if(myEnabled)
+    {
+        if(myFixedHorizon > 0) ofmsg("PosePredictor: constant velocity, horizon %1% ms", %myFixedHorizon);
+        else ofmsg("PosePredictor: constant velocity, measured horizon (max %1% ms)", %myMaxHorizon);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+PosePredictor::Track* PosePredictor::getTrack(Event* evt)
+{
+    uint64_t key = ((uint64_t)evt->getServiceType() << 32) | (uint32_t)evt->getSourceId();
+    Dictionary<uint64_t, Track*>::iterator it = myTracks.find(key);
+    if(it != myTracks.end()) return it->second;
+
+    Track* t = new Track();
+    t->time = 0;
+    t->position = Vector3f::Zero();
+    t->velocity = Vector3f::Zero();
+    t->orientation = Quaternion::Identity();
+    t->angularVelocity = Vector3f::Zero();
+    myTracks[key] = t;
+    return t;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void PosePredictor::updateError(Track* t, uint64_t timeUs, const Vector3f& position)
+{
+    // Compare the observed position with all predictions whose target time
+    // has passed.
+    while(!t->predictions.empty() && t->predictions.front().time <= timeUs)
+    {
+        float error = (t->predictions.front().position - position).norm();
+        if(myErrorStat == NULL)
+        {
+            StatsManager* sm = SystemManager::instance()->getStatsManager();
+            if(sm != NULL) myErrorStat = sm->createStat("pose prediction error", StatsManager::Count1);
+        }
+        if(myErrorStat != NULL) myErrorStat->addSample(error);
+        t->predictions.pop_front();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void PosePredictor::process(Event* evt, uint64_t dispatchTimeUs, uint64_t elapsedUs)
+{
+    Service::ServiceType st = evt->getServiceType();
+    bool pointer = (st == Service::Pointer);
+    if(!pointer && st != Service::Mocap && st != Service::Wand) return;
+    if(evt->getType() != Event::Update && evt->getType() != Event::Move) return;
+
+    double horizon = myFixedHorizon * 1000;
+    if(horizon <= 0) horizon = myMeasuredLatency - (double)elapsedUs;
+    if(horizon > myMaxHorizon * 1000) horizon = myMaxHorizon * 1000;
+    if(horizon < 0) horizon = 0;
+
+    Track* t = getTrack(evt);
+    Vector3f position = evt->getPosition();
+    Quaternion orientation = evt->getOrientation();
+
+    // Velocity is estimated over the times the samples were taken: the 
+    // event timestamp (in milliseconds) set by the service. Events in the 
+    // same frame share the dispatch time, so it is only a fallback for 
+    // services that do not stamp their events. Samples with the same time 
+    // do not update the velocity estimate.
+    uint64_t timeUs = evt->getTimestamp() != 0 ? (uint64_t)evt->getTimestamp() * 1000 : dispatchTimeUs;
+    if(t->time != 0 && timeUs > t->time)
+    {
+        double dt = (double)(timeUs - t->time) / 1000000.0;
+        if(dt < POSE_PREDICTOR_MAX_SAMPLE_GAP)
+        {
+            Vector3f velocity = (position - t->position) / (float)dt;
+            t->velocity = t->velocity * mySmoothing + velocity * (1 - mySmoothing);
+
+            AngleAxis delta(orientation * t->orientation.inverse());
+            Vector3f angularVelocity = delta.axis() * (float)(delta.angle() / dt);
+            t->angularVelocity = t->angularVelocity * mySmoothing + angularVelocity * (1 - mySmoothing);
+        }
+        else
+        {
+            t->velocity = Vector3f::Zero();
+            t->angularVelocity = Vector3f::Zero();
+            t->predictions.clear();
+        }
+    }
+    updateError(t, timeUs, position);
+    t->time = timeUs;
+    t->position = position;
+    t->orientation = orientation;
+
+    float h = (float)(horizon / 1000000.0);
+    Vector3f predictedPosition = position + t->velocity * h;
+    evt->setPosition(predictedPosition);
+
+    if(pointer)
+    {
+        // Pointer events generated by the window callbacks carry the view ray
+        // for their position: recompute it for the predicted position.
+        if(evt->getExtraDataType() == Event::ExtraDataVector3Array && evt->getExtraDataItems() >= 2)
+        {
+            DisplaySystem* ds = SystemManager::instance()->getDisplaySystem();
+            Ray ray = ds->getViewRay(Vector2i((int)predictedPosition[0], (int)predictedPosition[1]));
+            evt->setExtraDataVector3(0, ray.getOrigin());
+            evt->setExtraDataVector3(1, ray.getDirection());
+        }
+    }
+    else
+    {
+        float angle = t->angularVelocity.norm() * h;
+        if(angle > 0)
+        {
+            Quaternion rotation(AngleAxis(angle, t->angularVelocity.normalized()));
+            evt->setOrientation(rotation * orientation);
+        }
+    }
+
+    if(horizon > 0)
+    {
+        Prediction p;
+        p.time = timeUs + (uint64_t)horizon;
+        p.position = predictedPosition;
+        t->predictions.push_back(p);
+        if(t->predictions.size() > POSE_PREDICTOR_MAX_PENDING) t->predictions.pop_front();
+    }
+}
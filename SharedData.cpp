@@ -0,0 +1,1253 @@
+/******************************************************************************
+ * THE OMEGA LIB PROJECT
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2016		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2016, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file
+ *	The Equalizer implementation of the omegalib shared data services: a
+ *  distributed Collage object that serializes all registered SharedObjects
+ *  on the master and applies them on the slave nodes every frame.
+ ******************************************************************************/
+#include "eqinternal.h"
+
+using namespace omega;
+using namespace co::base;
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void EqualizerSharedOStream::write(const void* data, uint64_t size)
+{
+    myStream->write(data, size);
+    myBytes += size;
+    if(myHash != NULL) myHash->update(data, size);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+SharedOStream& EqualizerSharedOStream::operator<< (const String& str)
+{
+    const uint64_t nElems = str.length();
+    write(&nElems, sizeof(nElems));
+    if (nElems > 0)
+        write(str.c_str(), nElems);
+
+
+    return *this;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void EqualizerSharedIStream::read(void* data, uint64_t size)
+{
+    if(myStream != NULL) myStream->read(data, size);
+    else
+    {
+        if(myBytes + size > mySize)
+        {
+            oferror("EqualizerSharedIStream::read: reading %1% bytes past the end of the frame", 
+                %(myBytes + size - mySize));
+            size = mySize - myBytes;
+        }
+        if(size > 0) memcpy(data, myData + myBytes, size);
+    }
+    myBytes += size;
+    if(myHash != NULL) myHash->update(data, size);
+    if(myTee != NULL && size > 0)
+    {
+        const byte* bytes = static_cast<const byte*>(data);
+        myTee->insert(myTee->end(), bytes, bytes + size);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+SharedIStream& EqualizerSharedIStream::operator>> (String& str)
+{
+    uint64_t nElems = 0;
+    read(&nElems, sizeof(nElems));
+    if(myStream == NULL)
+    {
+        // Recorded frame
+        if(nElems > mySize - myBytes)
+        {
+            oferror("SharedDataServices: nElems(%1%) > remaining frame size(%2%)",
+                %nElems %(mySize - myBytes));
+            nElems = mySize - myBytes;
+        }
+        str.assign((const char*)(myData + myBytes), nElems);
+        myBytes += nElems;
+        if(myHash != NULL) myHash->update(str.data(), nElems);
+        if(myTee != NULL) myTee->insert(myTee->end(), str.begin(), str.end());
+        return *this;
+    }
+    if (nElems > myStream->getRemainingBufferSize())
+    {
+        oferror("SharedDataServices: nElems(%1%) > getRemainingBufferSize(%2%)",
+            %nElems %myStream->getRemainingBufferSize());
+    }
+    oassert(nElems <= myStream->getRemainingBufferSize());
+    if (nElems == 0)
+        str.clear();
+    else
+    {
+        str.assign(static_cast< const char* >(myStream->getRemainingBuffer()),
+            nElems);
+        myStream->advanceBuffer(nElems);
+        myBytes += nElems;
+        if(myHash != NULL) myHash->update(str.data(), nElems);
+        if(myTee != NULL) myTee->insert(myTee->end(), str.begin(), str.end());
+    }
+    return *this;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void EqualizerSharedIStream::skipRemaining()
+{
+    // Read through the data, so it is still hashed and teed.
+    byte chunk[4096];
+    while(true)
+    {
+        uint64_t left = myStream != NULL ? myStream->getRemainingBufferSize() : mySize - myBytes;
+        if(left == 0) break;
+        read(chunk, min(left, (uint64_t)sizeof(chunk)));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+SharedOStream& BufferSharedOStream::operator<< (const String& str)
+{
+    const uint64_t nElems = str.length();
+    write(&nElems, sizeof(nElems));
+    if (nElems > 0)
+        write(str.c_str(), nElems);
+    return *this;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void BufferSharedOStream::write(const void* data, uint64_t size)
+{
+    const byte* bytes = static_cast<const byte*>(data);
+    myBuffer->insert(myBuffer->end(), bytes, bytes + size);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void BufferSharedIStream::read(void* data, uint64_t size)
+{
+    if(myPosition + size > myBuffer->size())
+    {
+        oferror("BufferSharedIStream::read: reading %1% bytes past the end of the buffer", 
+            %(myPosition + size - myBuffer->size()));
+        size = myBuffer->size() - myPosition;
+    }
+    if(size > 0) memcpy(data, &(*myBuffer)[myPosition], size);
+    myPosition += size;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+SharedIStream& BufferSharedIStream::operator>> (String& str)
+{
+    uint64_t nElems = 0;
+    read(&nElems, sizeof(nElems));
+    if (nElems > myBuffer->size() - myPosition)
+    {
+        oferror("BufferSharedIStream: nElems(%1%) > remaining buffer size(%2%)",
+            %nElems %(myBuffer->size() - myPosition));
+        nElems = myBuffer->size() - myPosition;
+    }
+    if (nElems == 0)
+        str.clear();
+    else
+    {
+        str.assign(reinterpret_cast< const char* >(&(*myBuffer)[myPosition]), nElems);
+        myPosition += nElems;
+    }
+    return *this;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Applies an update, previously copied to the object scratch buffer, on a 
+// worker thread. Tasks run concurrently, so each one times itself with the
+// frame clock.
+class ApplyTask: public WorkerTask
+{
+public:
+    ApplyTask(const String& id, SharedObjectEntry* entry): 
+        myId(id), myEntry(entry) {}
+    virtual void execute()
+    {
+        uint64_t startTime = FrameClock::now();
+        BufferSharedIStream in(&myEntry->buffer);
+        myEntry->object->updateSharedData(in);
+        myEntry->lastTime = (FrameClock::now() - startTime) / 1000.0;
+    }
+    const String& getId() { return myId; }
+    SharedObjectEntry* getEntry() { return myEntry; }
+private:
+    String myId;
+    Ref<SharedObjectEntry> myEntry;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Serializes a shared object into its scratch buffer. Tasks run concurrently,
+// so each one times itself with the frame clock.
+class SerializeTask: public WorkerTask
+{
+public:
+    SerializeTask(SharedObjectEntry* entry): myEntry(entry) {}
+    virtual void execute()
+    {
+        uint64_t startTime = FrameClock::now();
+        myEntry->buffer.clear();
+        BufferSharedOStream out(&myEntry->buffer);
+        myEntry->object->commitSharedData(out);
+        myEntry->lastTime = (FrameClock::now() - startTime) / 1000.0;
+    }
+private:
+    SharedObjectEntry* myEntry;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+SharedData::SharedData():
+    myFrameTime(0),
+    myLastFrameSize(0),
+    myInputAge(NoInput),
+    myLocalFrameTime(0),
+    myCommitClock(0),
+    myProfilingEnabled(false),
+    myReportInterval(0),
+    myReportCount(5),
+    myFramesSinceReport(0),
+    myWorkerPool(NULL),
+    myChangeTrackingEnabled(false),
+    myContentHash(0),
+    myPreviousContentHash(0),
+    myHasCommitted(false),
+    myPacking(false),
+    myBulkLane(NULL),
+    mySource(NULL),
+    myRelay(NULL),
+    myDivergenceCheck(false),
+    myStreamHash(0),
+    myBuffered(false),
+    myStreamBudget(1024 * 1024)
+{
+    myTimer.start();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+SharedData::~SharedData()
+{
+    finishApply();
+    delete myWorkerPool;
+
+    foreach(StreamTransfer* t, myQueuedStreams) delete t;
+    foreach(StreamTransfer* t, myOutgoingStreams) delete t;
+    foreach(StreamTransfer* t, myCompletedStreams) delete t;
+    typedef Dictionary<String, StreamTransfer*>::Item StreamItem;
+    foreach(StreamItem t, myIncomingStreams) delete t.second;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::setup(Setting& s)
+{
+    setProfilingEnabled(
+        Config::getBoolValue("sharedDataProfiler", s, false),
+        Config::getIntValue("sharedDataReportInterval", s, 0),
+        Config::getIntValue("sharedDataReportCount", s, 5));
+    setParallelSerialization(
+        Config::getIntValue("sharedDataThreads", s, 0),
+        getStringList("parallelSharedObjects", s));
+    setParallelApply(
+        getStringList("parallelApplySharedObjects", s),
+        getStringList("deferredSharedObjects", s));
+    setStreamBudget(max(1, Config::getIntValue("sharedStreamBudget", s, 1024 * 1024)));
+    myBulkIds = getStringList("bulkSharedObjects", s);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::setObjectLane(const String& id, Lane lane)
+{
+    Vector<String>::iterator it = find(myBulkIds.begin(), myBulkIds.end(), id);
+    if(lane == BulkLane && it == myBulkIds.end()) myBulkIds.push_back(id);
+    else if(lane == PriorityLane && it != myBulkIds.end()) myBulkIds.erase(it);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+SharedData::Lane SharedData::getObjectLane(const String& id)
+{
+    if(find(myBulkIds.begin(), myBulkIds.end(), id) != myBulkIds.end()) return BulkLane;
+    return PriorityLane;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::addNodeLane(const String& node, SharedData* lane)
+{
+    myNodeLanes[node] = lane;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::setObjectInterest(const String& id, const Vector<String>& nodes)
+{
+    myInterests[id] = nodes;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::attachEntry(const String& id, SharedObjectEntry* entry)
+{
+    myLock.lock();
+    myObjects[id] = entry;
+    myLock.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool SharedData::addEntry(const String& id, SharedObjectEntry* entry, Vector<byte>& snapshot)
+{
+    myObjects[id] = entry;
+    if(entry->filtered)
+    {
+        foreach(String node, myInterests[id])
+        {
+            Dictionary<String, SharedData*>::iterator lane = myNodeLanes.find(node);
+            if(lane != myNodeLanes.end()) lane->second->attachEntry(id, entry);
+        }
+    }
+
+    Dictionary<String, Vector<byte> >::iterator it = myPendingSnapshots.find(id);
+    if(it == myPendingSnapshots.end()) return false;
+    snapshot.swap(it->second);
+    myPendingSnapshots.erase(it);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::setPacking(bool packing)
+{
+    myQueueLock.lock();
+    myPacking = packing;
+    myQueueLock.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::applyPendingRegistrations()
+{
+    List<PendingRegistration> pending;
+    myQueueLock.lock();
+    pending.swap(myPendingRegistrations);
+    myQueueLock.unlock();
+    if(pending.empty()) return;
+
+    // Snapshots are applied after the lock is released: objects may 
+    // register others while they update.
+    List< pair<SharedObject*, Vector<byte> > > snapshots;
+    myLock.lock();
+    foreach(PendingRegistration& r, pending)
+    {
+        if(r.entry == NULL)
+        {
+            myObjects.erase(r.id);
+            continue;
+        }
+        Vector<byte> snapshot;
+        if(addEntry(r.id, r.entry, snapshot))
+        {
+            snapshots.push_back(make_pair(r.entry->object, Vector<byte>()));
+            snapshots.back().second.swap(snapshot);
+        }
+    }
+    myLock.unlock();
+
+    typedef pair<SharedObject*, Vector<byte> > SnapshotItem;
+    foreach(SnapshotItem& s, snapshots)
+    {
+        BufferSharedIStream in(&s.second);
+        s.first->updateSharedData(in);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::setChangeTrackingEnabled(bool enabled)
+{
+    myChangeTrackingEnabled = enabled;
+    if(myBulkLane != NULL) myBulkLane->setChangeTrackingEnabled(enabled);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool SharedData::hasChanged()
+{
+    // Pending transfers advance at each commit.
+    myQueueLock.lock();
+    bool queued = !myQueuedStreams.empty();
+    myQueueLock.unlock();
+    return myContentHash != myPreviousContentHash || 
+        queued || !myOutgoingStreams.empty() ||
+        (myBulkLane != NULL && myBulkLane->hasChanged());
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::setParallelSerialization(int numThreads, const Vector<String>& parallelIds)
+{
+    finishApply();
+    delete myWorkerPool;
+    myWorkerPool = NULL;
+    myParallelIds = parallelIds;
+    if(numThreads > 0) myWorkerPool = new WorkerPool(numThreads);
+
+    foreach(SharedObjectItem obj, myObjects)
+    {
+        obj->parallel = isParallelObject(obj.getKey());
+        obj->applyMode = getApplyMode(obj.getKey());
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::setParallelApply(const Vector<String>& parallelIds, const Vector<String>& deferredIds)
+{
+    finishApply();
+    myParallelApplyIds = parallelIds;
+    myDeferredApplyIds = deferredIds;
+
+    foreach(SharedObjectItem obj, myObjects)
+    {
+        obj->applyMode = getApplyMode(obj.getKey());
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+SharedObjectEntry::ApplyMode SharedData::getApplyMode(const String& id)
+{
+    if(myWorkerPool != NULL)
+    {
+        foreach(String pid, myDeferredApplyIds)
+        {
+            if(pid == "*" || pid == id) return SharedObjectEntry::ApplyDeferred;
+        }
+        foreach(String pid, myParallelApplyIds)
+        {
+            if(pid == "*" || pid == id) return SharedObjectEntry::ApplyParallel;
+        }
+    }
+    return SharedObjectEntry::ApplyImmediate;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::joinApplyTasks(WorkerTaskGroup& group, List<WorkerTask*>& tasks)
+{
+    if(tasks.empty()) return;
+    group.wait();
+    foreach(WorkerTask* t, tasks)
+    {
+        ApplyTask* task = static_cast<ApplyTask*>(t);
+        SharedObjectEntry* entry = task->getEntry();
+        if(myProfilingEnabled) profileObject(task->getId(), entry, entry->buffer.size(), entry->lastTime);
+        delete task;
+    }
+    tasks.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::finishApply()
+{
+    joinApplyTasks(myParallelApplyGroup, myParallelApplyTasks);
+    joinApplyTasks(myDeferredApplyGroup, myDeferredApplyTasks);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool SharedData::isParallelObject(const String& id)
+{
+    if(myWorkerPool == NULL) return false;
+    foreach(String pid, myParallelIds)
+    {
+        if(pid == "*" || pid == id) return true;
+    }
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::setProfilingEnabled(bool enabled, int reportInterval, int reportCount)
+{
+    myProfilingEnabled = enabled;
+    myReportInterval = reportInterval;
+    myReportCount = reportCount;
+    myFramesSinceReport = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::registerObject(SharedObject* module, const String& sharedId)
+{
+    Dictionary<String, Vector<String> >::iterator interest = myInterests.find(sharedId);
+    bool filtered = interest != myInterests.end() && !myNodeLanes.empty();
+    if(filtered && myLocalNode != "")
+    {
+        // Slaves only receive the object if they are interested in it.
+        const Vector<String>& nodes = interest->second;
+        if(find(nodes.begin(), nodes.end(), myLocalNode) != nodes.end())
+        {
+            myNodeLanes[myLocalNode]->registerObject(module, sharedId);
+        }
+        return;
+    }
+
+    if(myBulkLane != NULL && getObjectLane(sharedId) == BulkLane)
+    {
+        myBulkLane->registerObject(module, sharedId);
+        return;
+    }
+
+    //ofmsg("SharedData::registerObject: registering %1%", %sharedId);
+    SharedObjectEntry* entry = new SharedObjectEntry(module);
+    entry->parallel = isParallelObject(sharedId);
+    entry->applyMode = getApplyMode(sharedId);
+    entry->filtered = filtered;
+
+    // Objects registered while objects are serialized are queued, and so 
+    // is everything after them, to keep registrations in order.
+    myQueueLock.lock();
+    bool queued = myPacking || !myPendingRegistrations.empty();
+    if(queued)
+    {
+        PendingRegistration r;
+        r.id = sharedId;
+        r.entry = entry;
+        myPendingRegistrations.push_back(r);
+    }
+    myQueueLock.unlock();
+    if(queued) return;
+
+    Vector<byte> snapshot;
+    myLock.lock();
+    bool hasSnapshot = addEntry(sharedId, entry, snapshot);
+    myLock.unlock();
+
+    // If this node joined with a snapshot of this object, apply it now.
+    if(hasSnapshot)
+    {
+        BufferSharedIStream in(&snapshot);
+        module->updateSharedData(in);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::unregisterObject(const String& sharedId)
+{
+    Dictionary<String, Vector<String> >::iterator interest = myInterests.find(sharedId);
+    if(interest != myInterests.end() && !myNodeLanes.empty())
+    {
+        const Vector<String>& nodes = interest->second;
+        if(myLocalNode != "")
+        {
+            if(find(nodes.begin(), nodes.end(), myLocalNode) != nodes.end())
+            {
+                myNodeLanes[myLocalNode]->unregisterObject(sharedId);
+            }
+            return;
+        }
+        foreach(String node, nodes)
+        {
+            Dictionary<String, SharedData*>::iterator lane = myNodeLanes.find(node);
+            if(lane != myNodeLanes.end()) lane->second->unregisterObject(sharedId);
+        }
+    }
+
+    if(myBulkLane != NULL && getObjectLane(sharedId) == BulkLane)
+    {
+        myBulkLane->unregisterObject(sharedId);
+        return;
+    }
+
+    //ofmsg("SharedData::unregisterObject: unregistering %1%", %sharedId);
+    PendingRegistration r;
+    r.id = sharedId;
+    myQueueLock.lock();
+    myPendingRegistrations.push_back(r);
+    myQueueLock.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::clearObjects()
+{
+    // Called on slaves after unmapping: the engine that registered the 
+    // objects is going away, and the next mapping brings a full snapshot.
+    finishApply();
+    myLock.lock();
+    myObjects.clear();
+    myPendingSnapshots.clear();
+    typedef Dictionary<String, StreamTransfer*>::Item StreamItem;
+    foreach(StreamItem t, myIncomingStreams) delete t.second;
+    myIncomingStreams.clear();
+    myHasCommitted = false;
+    myLock.unlock();
+
+    myQueueLock.lock();
+    myPendingRegistrations.clear();
+    myQueueLock.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::profileObject(const String& id, SharedObjectEntry* entry, uint64_t bytes, double time)
+{
+    if(entry->timeStat == NULL)
+    {
+        StatsManager* sm = SystemManager::instance()->getStatsManager();
+        if(sm != NULL)
+        {
+            const char* phase = isMaster() ? "commit" : "apply";
+            entry->timeStat = sm->createStat(ostr("shared %1% %2%", %id %phase), StatsManager::Time);
+            entry->bytesStat = sm->createStat(ostr("shared %1% bytes", %id), StatsManager::Count1);
+        }
+    }
+    if(entry->timeStat != NULL)
+    {
+        entry->timeStat->addSample(time);
+        entry->bytesStat->addSample((double)bytes);
+    }
+    entry->lastBytes = bytes;
+    entry->totalBytes += bytes;
+    entry->totalTime += time;
+    entry->frames++;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Sorts objects by decreasing total bytes, then by decreasing total time.
+bool sharedObjectProfileGreater(const pair<String, SharedObjectEntry*>& a, const pair<String, SharedObjectEntry*>& b)
+{
+    if(a.second->totalBytes != b.second->totalBytes) return a.second->totalBytes > b.second->totalBytes;
+    return a.second->totalTime > b.second->totalTime;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::reportProfile()
+{
+    Vector< pair<String, SharedObjectEntry*> > entries;
+    foreach(SharedObjectItem obj, myObjects)
+    {
+        entries.push_back(pair<String, SharedObjectEntry*>(obj.getKey(), obj.second.get()));
+    }
+    sort(entries.begin(), entries.end(), sharedObjectProfileGreater);
+
+    const char* phase = isMaster() ? "commit" : "apply";
+    ofmsg("SharedData: top %1% of %2% objects over the last %3% frames (%4%)",
+        %min(myReportCount, (int)entries.size()) %entries.size() %myFramesSinceReport %phase);
+    for(int i = 0; i < entries.size() && i < myReportCount; i++)
+    {
+        SharedObjectEntry* e = entries[i].second;
+        int frames = max(e->frames, 1);
+        ofmsg("    %1%: %2% bytes/frame  %3% ms/frame", 
+            %entries[i].first %(e->totalBytes / frames) %(e->totalTime / frames));
+    }
+
+    foreach(SharedObjectItem obj, myObjects)
+    {
+        obj->totalBytes = 0;
+        obj->totalTime = 0;
+        obj->frames = 0;
+    }
+    myFramesSinceReport = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::setInputTime(uint64_t timeUs)
+{
+    myLocalFrameTime = FrameClock::now();
+    myInputAge = (timeUs != 0 && timeUs <= myLocalFrameTime) ? myLocalFrameTime - timeUs : NoInput;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::sendStream(const String& streamId, const void* data, uint64_t size)
+{
+    if(myBulkLane != NULL)
+    {
+        myBulkLane->sendStream(streamId, data, size);
+        return;
+    }
+
+    StreamTransfer* t = new StreamTransfer();
+    t->id = streamId;
+    t->offset = 0;
+    const byte* bytes = static_cast<const byte*>(data);
+    t->data.assign(bytes, bytes + size);
+
+    // Transfers start at the next commit.
+    myQueueLock.lock();
+    myQueuedStreams.push_back(t);
+    myQueueLock.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::addStreamListener(SharedStreamListener* listener)
+{
+    if(myBulkLane != NULL) myBulkLane->addStreamListener(listener);
+    else myStreamListeners.push_back(listener);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::removeStreamListener(SharedStreamListener* listener)
+{
+    if(myBulkLane != NULL) myBulkLane->removeStreamListener(listener);
+    else myStreamListeners.remove(listener);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::notifyStreamCompleted(const String& streamId, const Vector<byte>& data)
+{
+    const byte* bytes = data.empty() ? NULL : &data[0];
+    foreach(SharedStreamListener* l, myStreamListeners)
+    {
+        l->onSharedStreamCompleted(streamId, bytes, data.size());
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::advanceStreams()
+{
+    List<StreamTransfer*> queued;
+    myQueueLock.lock();
+    queued.swap(myQueuedStreams);
+    myQueueLock.unlock();
+    foreach(StreamTransfer* t, queued)
+    {
+        foreach(StreamTransfer* old, myOutgoingStreams)
+        {
+            if(old->id == t->id)
+            {
+                ofmsg("SharedData: restarting transfer of stream %1%", %t->id);
+                myOutgoingStreams.remove(old);
+                delete old;
+                break;
+            }
+        }
+        myOutgoingStreams.push_back(t);
+    }
+
+    // Transfers are served in the order they were started: the oldest one 
+    // gets as much of the budget as it can use.
+    myStreamChunks.clear();
+    uint64_t budget = myStreamBudget;
+    uint64_t bytes = 0;
+    List<StreamTransfer*>::iterator it = myOutgoingStreams.begin();
+    while(it != myOutgoingStreams.end())
+    {
+        StreamTransfer* t = *it;
+        uint64_t left = t->data.size() - t->offset;
+        if(budget == 0 && left > 0) break;
+        StreamChunk c;
+        c.transfer = t;
+        c.offset = t->offset;
+        c.size = min(budget, left);
+        myStreamChunks.push_back(c);
+        t->offset += c.size;
+        budget -= c.size;
+        bytes += c.size;
+
+        if(t->offset == t->data.size())
+        {
+            myCompletedStreams.push_back(t);
+            it = myOutgoingStreams.erase(it);
+        }
+        else it++;
+    }
+
+    if(!myStreamChunks.empty() || myStreamBytesStat != NULL)
+    {
+        if(myStreamBytesStat == NULL)
+        {
+            StatsManager* sm = SystemManager::instance()->getStatsManager();
+            if(sm != NULL) myStreamBytesStat = sm->createStat("shared stream bytes", StatsManager::Count1);
+        }
+        if(myStreamBytesStat != NULL) myStreamBytesStat->addSample((double)bytes);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::writeStreams(SharedOStream& out, bool commit)
+{
+    int numChunks = commit ? myStreamChunks.size() : 0;
+    out << numChunks;
+    for(int i = 0; i < numChunks; i++)
+    {
+        const StreamChunk& c = myStreamChunks[i];
+        StreamTransfer* t = c.transfer;
+        uint64_t total = t->data.size();
+        out << t->id << total << c.offset << c.size;
+        if(c.size > 0) out.write(&t->data[c.offset], c.size);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::applyStreams(SharedIStream& in)
+{
+    int numChunks;
+    in >> numChunks;
+    for(int i = 0; i < numChunks; i++)
+    {
+        String id;
+        uint64_t total;
+        uint64_t offset;
+        uint64_t chunk;
+        in >> id >> total >> offset >> chunk;
+
+        StreamTransfer* t = NULL;
+        Dictionary<String, StreamTransfer*>::iterator it = myIncomingStreams.find(id);
+        if(it != myIncomingStreams.end()) t = it->second;
+
+        // The first chunk starts (or restarts) a transfer.
+        if(offset == 0)
+        {
+            if(t == NULL)
+            {
+                t = new StreamTransfer();
+                t->id = id;
+                myIncomingStreams[id] = t;
+            }
+            t->data.resize(total);
+            t->offset = 0;
+        }
+
+        if(t == NULL || t->offset != offset || t->data.size() != total || offset + chunk > total)
+        {
+            // We joined in the middle of this transfer.
+            Vector<byte> skip(chunk);
+            if(chunk > 0) in.read(&skip[0], chunk);
+            continue;
+        }
+
+        if(chunk > 0) in.read(&t->data[offset], chunk);
+        t->offset += chunk;
+        if(t->offset == total)
+        {
+            myIncomingStreams.erase(id);
+            notifyStreamCompleted(id, t->data);
+            delete t;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::serializeObjects()
+{
+    // In buffered mode every object is serialized to its own scratch buffer
+    // first. This lets us prefix each object with its size (so slaves can 
+    // skip objects they do not know) and lets objects marked as parallel 
+    // serialize on worker threads, while the others serialize here.
+    Vector<SerializeTask> tasks;
+    tasks.reserve(myObjects.size());
+    foreach(SharedObjectItem obj, myObjects)
+    {
+        tasks.push_back(SerializeTask(obj.second));
+        if(obj->parallel && myWorkerPool != NULL) myWorkerPool->submit(&tasks.back());
+    }
+    int i = 0;
+    foreach(SharedObjectItem obj, myObjects)
+    {
+        if(!obj->parallel || myWorkerPool == NULL) tasks[i].execute();
+        i++;
+    }
+    if(myWorkerPool != NULL) myWorkerPool->wait();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool SharedData::isBuffered()
+{
+    if(myBuffered || myChangeTrackingEnabled || mySource != NULL || !myNodeLanes.empty()) return true;
+    // Slaves only apply objects in parallel or deferred from sized frames.
+    if(!myParallelApplyIds.empty() || !myDeferredApplyIds.empty()) return true;
+    foreach(SharedObjectItem obj, myObjects)
+    {
+        if(obj->parallel) return true;
+    }
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::writeObjectsDirect(EqualizerSharedOStream& eos)
+{
+    SharedOStream& out = eos;
+    out << myUpdateContext.frameNum << myUpdateContext.dt << myUpdateContext.time;
+    out << myFrameTime << myCommitClock << myInputAge;
+
+    // Objects are written without a size prefix: slaves need to know all of
+    // them.
+    bool sized = false;
+    int numObjects = myObjects.size();
+    out << sized << numObjects;
+    foreach(SharedObjectItem obj, myObjects)
+    {
+        out << obj.getKey();
+        uint64_t startBytes = eos.getBytesWritten();
+        double startTime = myTimer.getElapsedTimeInMilliSec();
+        obj->object->commitSharedData(out);
+        if(myProfilingEnabled)
+        {
+            profileObject(obj.getKey(), obj.second, 
+                eos.getBytesWritten() - startBytes, 
+                myTimer.getElapsedTimeInMilliSec() - startTime);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::writeObjects(SharedOStream& out)
+{
+    // Serialize update context.
+    out << myUpdateContext.frameNum << myUpdateContext.dt << myUpdateContext.time;
+    out << myFrameTime << myCommitClock << myInputAge;
+
+    // Filtered objects are written by the node lanes.
+    int numObjects = 0;
+    foreach(SharedObjectItem obj, myObjects)
+    {
+        if(!obj->filtered || mySource != NULL) numObjects++;
+    }
+    bool sized = true;
+    out << sized << numObjects;
+
+    foreach(SharedObjectItem obj, myObjects)
+    {
+        if(obj->filtered && mySource == NULL) continue;
+        uint64_t size = obj->buffer.size();
+        out << obj.getKey() << size;
+        if(size > 0) out.write(&obj->buffer[0], size);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+uint128_t SharedData::commit(const uint32_t incarnation)
+{
+    // Buffered objects are serialized here rather than in pack: Collage only
+    // packs versions that some node mapped, and change tracking, profiling
+    // and recordings need every version. Node lanes write buffers serialized
+    // by their source lane, which already profiled them.
+    applyPendingRegistrations();
+    if(mySource == NULL && isBuffered())
+    {
+        myLock.lock();
+        setPacking(true);
+        serializeObjects();
+
+        uint64_t hash = myObjects.size();
+        foreach(SharedObjectItem obj, myObjects)
+        {
+            uint64_t size = obj->buffer.size();
+            if(myChangeTrackingEnabled && size > 0) hash = xxhash64(&obj->buffer[0], size, hash);
+            if(myProfilingEnabled) profileObject(obj.getKey(), obj.second, size, obj->lastTime);
+        }
+        if(myChangeTrackingEnabled)
+        {
+            myPreviousContentHash = myContentHash;
+            myContentHash = hash;
+        }
+        myHasCommitted = true;
+        setPacking(false);
+        myLock.unlock();
+    }
+
+    // Transfers advance with every version, whether or not a node mapped 
+    // it: nodes joining in the middle of a transfer skip it.
+    myLock.lock();
+    advanceStreams();
+    myLock.unlock();
+
+    uint128_t version = co::Object::commit(incarnation);
+
+    // Listeners may start new transfers: notify them without the lock.
+    List<StreamTransfer*> completed;
+    myLock.lock();
+    myStreamChunks.clear();
+    completed.swap(myCompletedStreams);
+    myLock.unlock();
+    foreach(StreamTransfer* t, completed)
+    {
+        notifyStreamCompleted(t->id, t->data);
+        delete t;
+    }
+
+    if(myProfilingEnabled && myReportInterval > 0 && ++myFramesSinceReport >= myReportInterval)
+    {
+        reportProfile();
+    }
+    return version;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::pack(co::DataOStream& os)
+{
+    //omsg("#### SharedData::pack");
+    myLock.lock();
+    setPacking(true);
+
+    // Buffered objects were serialized by commit. Otherwise objects write 
+    // straight to the stream.
+    EqualizerSharedOStream eos(&os);
+    XXHash64 streamHash;
+    if(myDivergenceCheck) eos.setHash(&streamHash);
+    if(isBuffered()) writeObjects(eos);
+    else writeObjectsDirect(eos);
+    writeStreams(eos, true);
+    if(myDivergenceCheck) myStreamHash = streamHash.digest();
+
+    myLastFrameSize = eos.getBytesWritten();
+    myHasCommitted = true;
+
+    setPacking(false);
+    myLock.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::getInstanceData(co::DataOStream& os)
+{
+    //omsg("#### SharedData::getInstanceData");
+    // Called when a node maps the shared data. This may happen while the 
+    // application runs (a node joining late) on the Collage command thread:
+    // once the first frame has been committed, we send the object buffers 
+    // from the last commit instead of touching the objects. They are a
+    // consistent snapshot of the last frame.
+    // Node lanes share object buffers with their source lane.
+    if(mySource != NULL) mySource->myLock.lock();
+    myLock.lock();
+    double startTime = myTimer.getElapsedTimeInMilliSec();
+    // Without buffers (see setBuffered) we have no copy of the last commit
+    // and serialize the objects here.
+    if(!myHasCommitted || !isBuffered())
+    {
+        setPacking(true);
+        serializeObjects();
+        setPacking(false);
+    }
+
+    co::base::UUID bulkId;
+    if(myBulkLane != NULL) bulkId = myBulkLane->getID();
+    os << bulkId;
+    uint32_t numNodeLanes = myNodeLanes.size();
+    os << numNodeLanes;
+    typedef Dictionary<String, SharedData*>::Item NodeLaneItem;
+    foreach(NodeLaneItem lane, myNodeLanes)
+    {
+        os << lane.getKey() << lane.second->getID();
+    }
+
+    EqualizerSharedOStream eos(&os);
+    writeObjects(eos);
+    writeStreams(eos, false);
+
+    if(myHasCommitted)
+    {
+        ofmsg("SharedData: sent snapshot of %1% objects (%2% bytes) in %3% ms", 
+            %myObjects.size() %eos.getBytesWritten() 
+            %(myTimer.getElapsedTimeInMilliSec() - startTime));
+    }
+    myLock.unlock();
+    if(mySource != NULL) mySource->myLock.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::applyInstanceData(co::DataIStream& is)
+{
+    //omsg("#### SharedData::applyInstanceData");
+    // Called once, when this node maps the shared data: the data is a 
+    // snapshot of all objects on the master.
+    is >> myBulkLaneID;
+    uint32_t numNodeLanes;
+    is >> numNodeLanes;
+    for(uint32_t i = 0; i < numNodeLanes; i++)
+    {
+        String node;
+        co::base::UUID id;
+        is >> node >> id;
+        myNodeLaneIDs[node] = id;
+    }
+    EqualizerSharedIStream eis(&is);
+    applyObjects(eis, true);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::unpack(co::DataIStream& is)
+{
+    //omsg("#### SharedData::unpack");
+    EqualizerSharedIStream eis(&is);
+    applyObjects(eis, false);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::applyObjects(EqualizerSharedIStream& eis, bool snapshot)
+{
+    // Latency measurements on this node start when the frame data arrives.
+    myLocalFrameTime = FrameClock::now();
+
+    SharedIStream& in = eis;
+    XXHash64 streamHash;
+    if(myDivergenceCheck && !snapshot) eis.setHash(&streamHash);
+    if(myRelay != NULL)
+    {
+        myRelayBuffer.clear();
+        eis.setTee(&myRelayBuffer);
+    }
+
+    // Deferred updates from the previous frame need to complete before we
+    // overwrite their buffers or apply newer data to the same objects.
+    joinApplyTasks(myDeferredApplyGroup, myDeferredApplyTasks);
+    applyPendingRegistrations();
+
+    // Desrialize update context.
+    in >> myUpdateContext.frameNum >> myUpdateContext.dt >> myUpdateContext.time;
+    in >> myFrameTime >> myCommitClock >> myInputAge;
+
+    bool sized;
+    int numObjects;
+    in >> sized >> numObjects;
+
+    while (numObjects > 0)
+    {
+        String objId;
+        uint64_t size = 0;
+        in >> objId;
+        if(sized) in >> size;
+
+        uint64_t startBytes = eis.getBytesRead();
+        Dictionary<String, Ref<SharedObjectEntry> >::iterator it = myObjects.find(objId);
+        if(!sized && it == myObjects.end())
+        {
+            // Without a size we cannot skip the object, nor anything after it.
+            oferror("FATAL ERROR: SharedData: could not find object key %1%, dropping the rest of frame %2%", 
+                %objId %myUpdateContext.frameNum);
+            eis.skipRemaining();
+            return;
+        }
+        else if (sized && it != myObjects.end() && it->second->applyMode != SharedObjectEntry::ApplyImmediate && !snapshot)
+        {
+            // Copy the update to the object buffer and apply it on a worker.
+            SharedObjectEntry* entry = it->second;
+            entry->buffer.resize(size);
+            if(size > 0) in.read(&entry->buffer[0], size);
+
+            ApplyTask* task = new ApplyTask(objId, entry);
+            if(entry->applyMode == SharedObjectEntry::ApplyParallel)
+            {
+                myParallelApplyTasks.push_back(task);
+                myWorkerPool->submit(task, &myParallelApplyGroup);
+            }
+            else
+            {
+                myDeferredApplyTasks.push_back(task);
+                myWorkerPool->submit(task, &myDeferredApplyGroup);
+            }
+        }
+        else if (it != myObjects.end())
+        {
+            SharedObjectEntry* entry = it->second;
+            double startTime = myTimer.getElapsedTimeInMilliSec();
+            entry->object->updateSharedData(in);
+            if(!sized) size = eis.getBytesRead() - startBytes;
+            if(myProfilingEnabled)
+            {
+                profileObject(objId, entry, size, 
+                    myTimer.getElapsedTimeInMilliSec() - startTime);
+            }
+        }
+        else if(snapshot)
+        {
+            // Objects are usually registered after the node maps the shared
+            // data: keep their snapshot until they are.
+            myLock.lock();
+            Vector<byte>& buffer = myPendingSnapshots[objId];
+            buffer.resize(size);
+            if(size > 0) in.read(&buffer[0], size);
+            myLock.unlock();
+        }
+        else
+        {
+            oferror("SharedData::applyInstanceData: could not find object key %1%, skipping %2% bytes", %objId %size);
+        }
+
+        // Skip whatever the object did not read, so a mismatched or unknown
+        // object does not corrupt the rest of the stream.
+        uint64_t bytesRead = eis.getBytesRead() - startBytes;
+        if(bytesRead < size)
+        {
+            Vector<byte> skip(size - bytesRead);
+            in.read(&skip[0], skip.size());
+        }
+        else if(bytesRead > size)
+        {
+            oferror("FATAL ERROR: SharedData::applyInstanceData: object %1% read %2% bytes past its data", 
+                %objId %(bytesRead - size));
+        }
+
+        numObjects--;
+    };
+
+    applyStreams(in);
+
+    // Parallel updates need to be complete before Engine::update runs.
+    joinApplyTasks(myParallelApplyGroup, myParallelApplyTasks);
+
+    myLastFrameSize = eis.getBytesRead();
+    if(myDivergenceCheck && !snapshot) myStreamHash = streamHash.digest();
+    if(myRelay != NULL) myRelay->setFrame(myRelayBuffer);
+
+    if(!snapshot && myProfilingEnabled && myReportInterval > 0 && ++myFramesSinceReport >= myReportInterval)
+    {
+        reportProfile();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::recordFrame(SharedDataRecording* recording)
+{
+    // Recordings need buffered mode: the buffers hold the last commit.
+    myLock.lock();
+    myRecordBuffer.clear();
+    BufferSharedOStream out(&myRecordBuffer);
+    writeObjects(out);
+    // Progressive transfers are not recorded.
+    writeStreams(out, false);
+    myLock.unlock();
+
+    recording->append(myUpdateContext.frameNum, myRecordBuffer);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void SharedData::applyRecordedFrame(const byte* data, uint64_t size, bool snapshot)
+{
+    EqualizerSharedIStream eis(data, size);
+    applyObjects(eis, snapshot);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+uint64_t SharedData::hashObjects(const Vector<String>& ids)
+{
+    uint64_t hash = 0;
+    myLock.lock();
+    foreach(String id, ids)
+    {
+        Dictionary<String, Ref<SharedObjectEntry> >::iterator it = myObjects.find(id);
+        if(it == myObjects.end()) continue;
+        myHashBuffer.clear();
+        BufferSharedOStream out(&myHashBuffer);
+        it->second->object->commitSharedData(out);
+        if(!myHashBuffer.empty()) hash = xxhash64(&myHashBuffer[0], myHashBuffer.size(), hash);
+    }
+    myLock.unlock();
+    return hash;
+}
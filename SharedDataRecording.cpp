@@ -0,0 +1,373 @@
+/******************************************************************************
+ * THE OMEGA LIB PROJECT
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2016		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2016, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file
+ *	Memory-mapped recording of the shared data stream, for replay.
+ ******************************************************************************/
+#include "eqinternal.h"
+
+#ifdef OMEGA_OS_WIN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace omega;
+using namespace co::base;
+using namespace std;
+
+// The file grows in steps of this size, to avoid remapping at every frame.
+#define RECORDING_GROWTH (64 * 1024 * 1024)
+
+///////////////////////////////////////////////////////////////////////////////
+struct RecordingHeader
+{
+    char magic[8];
+    // End of the last complete record. Updated after each record is written.
+    uint64_t end;
+    // Frame index (uint64_t record offsets), written on close.
+    uint64_t indexOffset;
+    uint64_t numFrames;
+    // Size of the elements of each record (input captures: sizeof(Event)), 
+    // 0 for shared data versions.
+    uint32_t elementSize;
+    uint32_t reserved;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+struct RecordHeader
+{
+    // Payload size. Records are padded to 8 bytes.
+    uint64_t size;
+    uint32_t frameNum;
+    uint32_t reserved;
+};
+
+static const char RecordingMagic[8] = { 'O', 'M', 'S', 'D', 'R', 'E', 'C', '2' };
+static const char CaptureMagic[8] = { 'O', 'M', 'I', 'N', 'C', 'A', 'P', '1' };
+
+///////////////////////////////////////////////////////////////////////////////
+static uint64_t recordSize(uint64_t payload)
+{
+    return sizeof(RecordHeader) + ((payload + 7) & ~(uint64_t)7);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+SharedDataRecording::SharedDataRecording():
+    myWriting(false),
+    myData(NULL),
+    myMappedSize(0),
+    myEnd(0),
+    myFile(-1),
+    myMapping(NULL)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+SharedDataRecording::~SharedDataRecording()
+{
+    close();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool SharedDataRecording::create(const String& path, Type type, uint32_t elementSize)
+{
+    close();
+    myPath = path;
+    myWriting = true;
+#ifdef OMEGA_OS_WIN
+    HANDLE f = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+        NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(f == INVALID_HANDLE_VALUE)
+#else
+    int f = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(f < 0)
+#endif
+    {
+        ofwarn("SharedDataRecording: could not create %1%", %path);
+        return false;
+    }
+    myFile = (intptr_t)f;
+
+    if(!mapFile(RECORDING_GROWTH, true)) 
+    {
+        close();
+        return false;
+    }
+    RecordingHeader* header = (RecordingHeader*)myData;
+    memcpy(header->magic, type == InputCapture ? CaptureMagic : RecordingMagic, sizeof(header->magic));
+    header->indexOffset = 0;
+    header->numFrames = 0;
+    header->elementSize = elementSize;
+    header->reserved = 0;
+    myEnd = sizeof(RecordingHeader);
+    header->end = myEnd;
+    myIndex.clear();
+    ofmsg("SharedDataRecording: recording %1% to %2%", 
+        %(type == InputCapture ? "input" : "the shared data") %path);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool SharedDataRecording::open(const String& path, Type type, uint32_t elementSize)
+{
+    close();
+    myPath = path;
+    myWriting = false;
+    uint64_t size = 0;
+#ifdef OMEGA_OS_WIN
+    HANDLE f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    LARGE_INTEGER fileSize;
+    if(f == INVALID_HANDLE_VALUE || !GetFileSizeEx(f, &fileSize))
+    {
+        if(f != INVALID_HANDLE_VALUE) CloseHandle(f);
+        ofwarn("SharedDataRecording: could not open %1%", %path);
+        return false;
+    }
+    size = fileSize.QuadPart;
+#else
+    int f = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if(f < 0 || fstat(f, &st) != 0)
+    {
+        if(f >= 0) ::close(f);
+        ofwarn("SharedDataRecording: could not open %1%", %path);
+        return false;
+    }
+    size = st.st_size;
+#endif
+    myFile = (intptr_t)f;
+
+    const char* kind = type == InputCapture ? "an input capture" : "a shared data recording";
+    if(size < sizeof(RecordingHeader) || !mapFile(size, false))
+    {
+        ofwarn("SharedDataRecording: %1% is not %2%", %path %kind);
+        close();
+        return false;
+    }
+    RecordingHeader* header = (RecordingHeader*)myData;
+    const char* magic = type == InputCapture ? CaptureMagic : RecordingMagic;
+    if(memcmp(header->magic, magic, sizeof(header->magic)) != 0 || !readIndex())
+    {
+        ofwarn("SharedDataRecording: %1% is not %2%", %path %kind);
+        close();
+        return false;
+    }
+    if(header->elementSize != elementSize)
+    {
+        // i.e. an input capture from a build with a different Event layout.
+        ofwarn("SharedDataRecording: %1% was written with %2% byte elements, this build uses %3%", 
+            %path %header->elementSize %elementSize);
+        close();
+        return false;
+    }
+    ofmsg("SharedDataRecording: %1%: %2% frames", %path %myIndex.size());
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool SharedDataRecording::readIndex()
+{
+    RecordingHeader* header = (RecordingHeader*)myData;
+    myEnd = header->end;
+    if(myEnd > myMappedSize) return false;
+
+    myIndex.clear();
+    uint64_t indexSize = header->numFrames * sizeof(uint64_t);
+    if(header->indexOffset != 0 && header->indexOffset + indexSize <= myMappedSize)
+    {
+        const uint64_t* index = (const uint64_t*)(myData + header->indexOffset);
+        myIndex.assign(index, index + header->numFrames);
+        return true;
+    }
+
+    // No index: the recording was not closed. Scan the records.
+    owarn("SharedDataRecording: the recording was not closed, rebuilding the frame index");
+    uint64_t offset = sizeof(RecordingHeader);
+    while(offset + sizeof(RecordHeader) <= myEnd)
+    {
+        const RecordHeader* rh = (const RecordHeader*)(myData + offset);
+        uint64_t next = offset + recordSize(rh->size);
+        if(next > myEnd) break;
+        myIndex.push_back(offset);
+        offset = next;
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void SharedDataRecording::close()
+{
+    if(myData != NULL && myWriting)
+    {
+        // Append the frame index. If the file cannot grow, reserve unmaps it
+        // and the recording is left without an index.
+        uint64_t indexSize = myIndex.size() * sizeof(uint64_t);
+        reserve(myEnd + indexSize);
+    }
+    if(myData != NULL && myWriting)
+    {
+        uint64_t indexSize = myIndex.size() * sizeof(uint64_t);
+        if(indexSize > 0) memcpy(myData + myEnd, &myIndex[0], indexSize);
+        RecordingHeader* header = (RecordingHeader*)myData;
+        header->indexOffset = myEnd;
+        header->numFrames = myIndex.size();
+        unmapFile();
+
+        // Trim the space reserved for growth.
+        uint64_t size = myEnd + indexSize;
+#ifdef OMEGA_OS_WIN
+        LARGE_INTEGER pos;
+        pos.QuadPart = size;
+        SetFilePointerEx((HANDLE)myFile, pos, NULL, FILE_BEGIN);
+        SetEndOfFile((HANDLE)myFile);
+#else
+        if(ftruncate((int)myFile, size) != 0) ofwarn("SharedDataRecording: could not trim %1%", %myPath);
+#endif
+        ofmsg("SharedDataRecording: %1%: %2% frames, %3% bytes", 
+            %myPath %myIndex.size() %size);
+    }
+    unmapFile();
+    if(myFile != -1)
+    {
+#ifdef OMEGA_OS_WIN
+        CloseHandle((HANDLE)myFile);
+#else
+        ::close((int)myFile);
+#endif
+        myFile = -1;
+    }
+    myIndex.clear();
+    myEnd = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void SharedDataRecording::append(uint32_t frameNum, const Vector<byte>& data)
+{
+    if(myData == NULL || !myWriting) return;
+
+    uint64_t next = myEnd + recordSize(data.size());
+    reserve(next);
+    if(myData == NULL) return;
+
+    RecordHeader* rh = (RecordHeader*)(myData + myEnd);
+    rh->size = data.size();
+    rh->frameNum = frameNum;
+    rh->reserved = 0;
+    if(!data.empty()) memcpy(myData + myEnd + sizeof(RecordHeader), &data[0], data.size());
+    myIndex.push_back(myEnd);
+
+    // Publish the record only once it is complete.
+    myEnd = next;
+    ((RecordingHeader*)myData)->end = myEnd;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+const byte* SharedDataRecording::getFrame(int index, uint32_t* frameNum, uint64_t* size)
+{
+    if(myData == NULL || index < 0 || index >= myIndex.size()) return NULL;
+    const RecordHeader* rh = (const RecordHeader*)(myData + myIndex[index]);
+    if(frameNum != NULL) *frameNum = rh->frameNum;
+    if(size != NULL) *size = rh->size;
+    return myData + myIndex[index] + sizeof(RecordHeader);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void SharedDataRecording::reserve(uint64_t size)
+{
+    if(size <= myMappedSize) return;
+    uint64_t newSize = myMappedSize + RECORDING_GROWTH;
+    if(newSize < size) newSize = size + RECORDING_GROWTH;
+    unmapFile();
+    if(!mapFile(newSize, true))
+    {
+        oferror("SharedDataRecording: could not grow %1% to %2% bytes, recording stopped", 
+            %myPath %newSize);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool SharedDataRecording::mapFile(uint64_t size, bool write)
+{
+#ifdef OMEGA_OS_WIN
+    // Mapping a writable view larger than the file extends the file.
+    HANDLE mapping = CreateFileMappingA((HANDLE)myFile, NULL, 
+        write ? PAGE_READWRITE : PAGE_READONLY, 
+        (DWORD)(size >> 32), (DWORD)(size & 0xffffffff), NULL);
+    void* data = NULL;
+    if(mapping != NULL)
+    {
+        data = MapViewOfFile(mapping, write ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+        if(data == NULL) CloseHandle(mapping);
+    }
+    if(data == NULL)
+    {
+        ofwarn("SharedDataRecording: could not map %1%", %myPath);
+        return false;
+    }
+    myMapping = mapping;
+#else
+    if(write && ftruncate((int)myFile, size) != 0)
+    {
+        ofwarn("SharedDataRecording: could not resize %1%", %myPath);
+        return false;
+    }
+    void* data = mmap(NULL, size, write ? PROT_READ | PROT_WRITE : PROT_READ, 
+        MAP_SHARED, (int)myFile, 0);
+    if(data == MAP_FAILED)
+    {
+        ofwarn("SharedDataRecording: could not map %1%", %myPath);
+        return false;
+    }
+#endif
+    myData = (byte*)data;
+    myMappedSize = size;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void SharedDataRecording::unmapFile()
+{
+    if(myData == NULL) return;
+#ifdef OMEGA_OS_WIN
+    UnmapViewOfFile(myData);
+    CloseHandle((HANDLE)myMapping);
+    myMapping = NULL;
+#else
+    munmap(myData, myMappedSize);
+#endif
+    myData = NULL;
+    myMappedSize = 0;
+}
@@ -0,0 +1,104 @@
+/******************************************************************************
+ * THE OMEGA LIB PROJECT
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2016		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2016, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file
+ *	Forwarding of the shared data through a tree of relay nodes.
+ ******************************************************************************/
+#include "eqinternal.h"
+
+using namespace omega;
+using namespace co::base;
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+co::base::UUID SharedDataRelay::getRelayID(const String& nodeKey)
+{
+    // Two hashes with different seeds make up the 128 bit id.
+    String key = "omega-relay-" + nodeKey;
+    return co::base::UUID(
+        xxhash64(key.c_str(), key.length(), 1),
+        xxhash64(key.c_str(), key.length(), 2));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+SharedDataRelay::SharedDataRelay(SharedData* source):
+    mySource(source)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void SharedDataRelay::setFrame(const Vector<byte>& data)
+{
+    myLock.lock();
+    myFrame = data;
+    myLock.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void SharedDataRelay::getInstanceData(co::DataOStream& os)
+{
+    // Same layout as SharedData::getInstanceData. Lanes are not relayed:
+    // children map them from the master.
+    os << mySource->getBulkLaneID();
+    const Dictionary<String, co::base::UUID>& lanes = mySource->getNodeLaneIDs();
+    uint32_t numNodeLanes = lanes.size();
+    os << numNodeLanes;
+    typedef Dictionary<String, co::base::UUID>::const_iterator LaneIterator;
+    for(LaneIterator it = lanes.begin(); it != lanes.end(); it++)
+    {
+        os << it->first << it->second;
+    }
+
+    myLock.lock();
+    if(!myFrame.empty()) os.write(&myFrame[0], myFrame.size());
+    myLock.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void SharedDataRelay::applyInstanceData(co::DataIStream& is)
+{
+    // Children map relays with a SharedData instance.
+    oerror("SharedDataRelay::applyInstanceData: relays are not mapped directly");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void SharedDataRelay::pack(co::DataOStream& os)
+{
+    myLock.lock();
+    if(!myFrame.empty()) os.write(&myFrame[0], myFrame.size());
+    myLock.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void SharedDataRelay::unpack(co::DataIStream& is)
+{
+    oerror("SharedDataRelay::unpack: relays are not mapped directly");
+}
@@ -0,0 +1,253 @@
+/******************************************************************************
+ * THE OMEGA LIB PROJECT
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2016		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2016, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file
+ *	Placement of the node and pipe threads on CPU sets and NUMA nodes.
+ ******************************************************************************/
+#include "eqinternal.h"
+
+#include <fstream>
+#include <algorithm>
+#include <stdlib.h>
+#ifdef OMEGA_OS_LINUX
+#include <pthread.h>
+#include <sched.h>
+#include <dirent.h>
+#endif
+#ifdef OMEGA_OS_WIN
+#include <windows.h>
+#endif
+
+using namespace omega;
+using namespace co::base;
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+ThreadAffinity::ThreadAffinity():
+    myMode(Manual)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ThreadAffinity::setup(Setting& s)
+{
+    String mode = Config::getStringValue("threadAffinity", s, "none");
+    if(mode == "auto") myMode = Auto;
+    else if(mode == "manual") myMode = Manual;
+    else ofwarn("ThreadAffinity: unknown threadAffinity mode %1%, using manual", %mode);
+
+    myNodeCpus = Config::getStringValue("nodeThreadCpus", s, "");
+    myPipeCpus = getStringList("pipeThreadCpus", s);
+    myDevicePciAddresses = getStringList("devicePciAddresses", s);
+
+#ifndef OMEGA_OS_LINUX
+    if(myMode == Auto)
+    {
+        owarn("ThreadAffinity: NUMA detection is only supported on linux, auto mode only uses the configured CPU sets");
+    }
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ThreadAffinity::pinNodeThread(int device)
+{
+    int numaNode = -1;
+    Vector<int> cpus;
+    if(myNodeCpus != "") cpus = parseCpuList(myNodeCpus);
+    else if(myMode == Auto) cpus = getDeviceCpus(device, numaNode);
+
+    pin("node thread", cpus, numaNode);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ThreadAffinity::pinPipeThread(const String& pipeName, int device)
+{
+    int numaNode = -1;
+    Vector<int> cpus = getDeviceCpus(device, numaNode);
+    pin(ostr("pipe %1% (device %2%)", %pipeName %device), cpus, numaNode);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+Vector<int> ThreadAffinity::getDeviceCpus(int device, int& numaNode)
+{
+    numaNode = -1;
+    if(device >= 0 && device < (int)myPipeCpus.size() && myPipeCpus[device] != "")
+    {
+        return parseCpuList(myPipeCpus[device]);
+    }
+    if(myMode != Auto) return Vector<int>();
+
+#ifdef OMEGA_OS_LINUX
+    numaNode = getDeviceNumaNode(device);
+    if(numaNode < 0) return Vector<int>();
+
+    ifstream f(ostr("/sys/devices/system/node/node%1%/cpulist", %numaNode).c_str());
+    String list;
+    if(f.good()) getline(f, list);
+    return parseCpuList(list);
+#else
+    return Vector<int>();
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int ThreadAffinity::getDeviceNumaNode(int device)
+{
+#ifdef OMEGA_OS_LINUX
+    // Equalizer devices are X screens, and there is no portable way to map a
+    // screen to its GPU. The configuration can list the PCI address of each
+    // device (devicePciAddresses, i.e. "0000:3b:00.0"). Otherwise assume the
+    // usual one screen per GPU setup, with screens following the PCI bus 
+    // order.
+    String gpu;
+    if(device >= 0 && device < (int)myDevicePciAddresses.size())
+    {
+        gpu = ostr("/sys/bus/pci/devices/%1%", %myDevicePciAddresses[device]);
+    }
+    else
+    {
+        Vector<String> gpus;
+        DIR* dir = opendir("/sys/bus/pci/devices");
+        if(dir == NULL) return -1;
+        struct dirent* entry;
+        while((entry = readdir(dir)) != NULL)
+        {
+            if(entry->d_name[0] == '.') continue;
+            String path = ostr("/sys/bus/pci/devices/%1%", %entry->d_name);
+            ifstream cf((path + "/class").c_str());
+            String pciClass;
+            if(cf.good()) getline(cf, pciClass);
+            ifstream vf((path + "/vendor").c_str());
+            String vendor;
+            if(vf.good()) getline(vf, vendor);
+            // 0x0300xx: VGA controller, 0x0302xx: 3D controller. Servers 
+            // also have a VGA controller on their management chip (ASPEED, 
+            // Matrox), so only NVIDIA, AMD and Intel devices count.
+            bool display = StringUtils::startsWith(pciClass, "0x0300") || 
+                StringUtils::startsWith(pciClass, "0x0302");
+            bool gpuVendor = vendor == "0x10de" || vendor == "0x1002" || vendor == "0x8086";
+            if(display && gpuVendor) gpus.push_back(path);
+        }
+        closedir(dir);
+        sort(gpus.begin(), gpus.end());
+
+        if(device < 0 || device >= (int)gpus.size()) return -1;
+        gpu = gpus[device];
+    }
+
+    ifstream nf((gpu + "/numa_node").c_str());
+    int numaNode = -1;
+    if(nf.good()) nf >> numaNode;
+    return numaNode;
+#else
+    return -1;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ThreadAffinity::pin(const String& threadName, const Vector<int>& cpus, int numaNode)
+{
+    if(cpus.empty())
+    {
+        ofmsg("ThreadAffinity: %1% not pinned", %threadName);
+        return;
+    }
+
+    bool ok = false;
+#if defined(OMEGA_OS_LINUX)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    foreach(int cpu, cpus) if(cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    ok = pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(OMEGA_OS_WIN)
+    DWORD_PTR mask = 0;
+    foreach(int cpu, cpus) if(cpu < (int)sizeof(DWORD_PTR) * 8) mask |= ((DWORD_PTR)1 << cpu);
+    ok = SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#endif
+
+    String cpuList = toCpuList(cpus);
+    if(!ok)
+    {
+        ofwarn("ThreadAffinity: could not pin %1% to cpus %2%", %threadName %cpuList);
+    }
+    else if(numaNode >= 0)
+    {
+        ofmsg("ThreadAffinity: %1% pinned to cpus %2% (NUMA node %3%)", %threadName %cpuList %numaNode);
+    }
+    else
+    {
+        ofmsg("ThreadAffinity: %1% pinned to cpus %2%", %threadName %cpuList);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+Vector<int> ThreadAffinity::parseCpuList(const String& list)
+{
+    Vector<int> cpus;
+    Vector<String> ranges = StringUtils::split(list, ",");
+    foreach(String range, ranges)
+    {
+        StringUtils::trim(range);
+        if(range == "") continue;
+        int first = 0;
+        int last = 0;
+        size_t dash = range.find('-');
+        if(dash == String::npos)
+        {
+            first = last = atoi(range.c_str());
+        }
+        else
+        {
+            first = atoi(range.substr(0, dash).c_str());
+            last = atoi(range.substr(dash + 1).c_str());
+        }
+        for(int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+String ThreadAffinity::toCpuList(const Vector<int>& cpus)
+{
+    // Collapse consecutive cpus into ranges, as in the input format.
+    String result;
+    size_t i = 0;
+    while(i < cpus.size())
+    {
+        size_t j = i;
+        while(j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) j++;
+        if(result != "") result += ",";
+        if(j == i) result += ostr("%1%", %cpus[i]);
+        else result += ostr("%1%-%2%", %cpus[i] %cpus[j]);
+        i = j + 1;
+    }
+    return result;
+}
@@ -48,7 +48,9 @@ using namespace std;
 ///////////////////////////////////////////////////////////////////////////////
 WindowImpl::WindowImpl(eq::Pipe* parent): 
     eq::Window(parent),
-    myVisible(false), mySkipResize(false)
+    myTile(NULL), myVisible(false), mySkipResize(false),
+    myInputAge(SharedData::NoInput), myInputFrameTime(0),
+    myFrameNumber(0), myDrawTime(0), myDrawEnd(0)
     //myIndex(Vector2i::Zero())
 {
 }
@@ -102,6 +104,45 @@ bool WindowImpl::configExit()
     return Window::configExit();
 }
 
+///////////////////////////////////////////////////////////////////////////////
+uint64_t WindowImpl::getInputLatency()
+{
+    if(myInputAge == SharedData::NoInput) return SharedData::NoInput;
+    return myInputAge + FrameClock::now() - myInputFrameTime;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void WindowImpl::channelDrawn(uint64_t start, uint64_t end)
+{
+    myDrawTime += end - start;
+    myDrawEnd = end;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void WindowImpl::swapBuffers()
+{
+    uint64_t swapStart = FrameClock::now();
+    eq::Window::swapBuffers();
+
+    // With the swap barrier enabled, the time between the last draw and 
+    // the swap is mostly spent waiting for the other nodes.
+    FrameTimings* ft = static_cast<ConfigImpl*>(getConfig())->getFrameTimings();
+    if(ft->isEnabled() && myDrawEnd != 0)
+    {
+        uint64_t swap = FrameClock::now() - swapStart;
+        uint64_t wait = swapStart - myDrawEnd;
+        ft->addWindowFrame(getName(), myFrameNumber, myDrawTime, wait, swap);
+    }
+
+    // With vsync on, the swap returns close to when the frame reaches the
+    // display, so this is our best estimate of input-to-photon latency.
+    uint64_t latency = getInputLatency();
+    if(latency != SharedData::NoInput)
+    {
+        static_cast<ConfigImpl*>(getConfig())->getDisplayLatency()->addSample(latency);
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 bool WindowImpl::processEvent(const eq::Event& event) 
 {
@@ -149,6 +190,15 @@ bool WindowImpl::processEvent(const eq::Event& event)
 void WindowImpl::frameStart(const uint128_t& frameID, const uint32_t frameNumber)
 {
     eq::Window::frameStart(frameID, frameNumber);
+    myFrameNumber = frameNumber;
+    myDrawTime = 0;
+    myDrawEnd = 0;
+
+    // Shared data is updated by the node thread before window frames start,
+    // so it is safe to read here and keep for the rest of the frame.
+    SharedData* sd = static_cast<ConfigImpl*>(getConfig())->getSharedData();
+    myInputAge = sd->getInputAge();
+    myInputFrameTime = sd->getLocalFrameTime();
 
     // Invert interleaver based on window position, WIP
     //int windowY = getPixelViewport().y;
@@ -0,0 +1,88 @@
+/******************************************************************************
+ * THE OMEGA LIB PROJECT
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2016		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2016, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file
+ *	A simple pool of worker threads, used to spread per-frame work (like 
+ *  shared object serialization) over multiple cores.
+ ******************************************************************************/
+#include "eqinternal.h"
+
+using namespace omega;
+using namespace co::base;
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+WorkerPool::WorkerPool(int numThreads)
+{
+    for(int i = 0; i < numThreads; i++)
+    {
+        Worker* w = new Worker(this);
+        w->start();
+        myWorkers.push_back(w);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+WorkerPool::~WorkerPool()
+{
+    // A NULL task tells a worker to exit.
+    QueuedTask exitTask;
+    exitTask.task = NULL;
+    exitTask.group = NULL;
+    for(int i = 0; i < myWorkers.size(); i++) myQueue.push(exitTask);
+    foreach(Worker* w, myWorkers)
+    {
+        w->join();
+        delete w;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void WorkerPool::submit(WorkerTask* task, WorkerTaskGroup* group)
+{
+    QueuedTask qt;
+    qt.task = task;
+    qt.group = group != NULL ? group : &myDefaultGroup;
+    ++qt.group->myPendingTasks;
+    myQueue.push(qt);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void WorkerPool::Worker::run()
+{
+    while(true)
+    {
+        QueuedTask qt = myPool->myQueue.pop();
+        if(qt.task == NULL) break;
+        qt.task->execute();
+        --qt.group->myPendingTasks;
+    }
+}
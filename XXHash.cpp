@@ -0,0 +1,209 @@
+/******************************************************************************
+ * THE OMEGA LIB PROJECT
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2016		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2016, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file
+ *	A portable implementation of the 64-bit xxHash function (XXH64) by 
+ *  Yann Collet, one-shot and incremental, used to detect changes in the 
+ *  shared data stream and divergence between nodes.
+ ******************************************************************************/
+#include "eqinternal.h"
+
+using namespace omega;
+
+static const uint64_t PRIME64_1 = 11400714785074694791ULL;
+static const uint64_t PRIME64_2 = 14029467366897019727ULL;
+static const uint64_t PRIME64_3 = 1609587929392839161ULL;
+static const uint64_t PRIME64_4 = 9650029242287828579ULL;
+static const uint64_t PRIME64_5 = 2870177450012600261ULL;
+
+///////////////////////////////////////////////////////////////////////////////
+inline uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+///////////////////////////////////////////////////////////////////////////////
+inline uint64_t read64(const byte* p) { uint64_t v; memcpy(&v, p, sizeof(v)); return v; }
+
+///////////////////////////////////////////////////////////////////////////////
+inline uint32_t read32(const byte* p) { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+
+///////////////////////////////////////////////////////////////////////////////
+inline uint64_t xxhRound(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+inline uint64_t xxhMergeRound(uint64_t acc, uint64_t val)
+{
+    acc ^= xxhRound(0, val);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Mixes in the last (less than 32) bytes and avalanches the hash.
+static uint64_t xxhFinalize(uint64_t h, const byte* p, const byte* end)
+{
+    while(p + 8 <= end)
+    {
+        h ^= xxhRound(0, read64(p));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+    }
+    if(p + 4 <= end)
+    {
+        h ^= (uint64_t)read32(p) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    while(p < end)
+    {
+        h ^= (*p) * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+uint64_t omega::xxhash64(const void* data, size_t size, uint64_t seed)
+{
+    const byte* p = static_cast<const byte*>(data);
+    const byte* end = p + size;
+    uint64_t h;
+
+    if(size >= 32)
+    {
+        const byte* limit = end - 32;
+        uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+        uint64_t v2 = seed + PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME64_1;
+        do
+        {
+            v1 = xxhRound(v1, read64(p)); p += 8;
+            v2 = xxhRound(v2, read64(p)); p += 8;
+            v3 = xxhRound(v3, read64(p)); p += 8;
+            v4 = xxhRound(v4, read64(p)); p += 8;
+        } while(p <= limit);
+
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = xxhMergeRound(h, v1);
+        h = xxhMergeRound(h, v2);
+        h = xxhMergeRound(h, v3);
+        h = xxhMergeRound(h, v4);
+    }
+    else
+    {
+        h = seed + PRIME64_5;
+    }
+
+    h += (uint64_t)size;
+    return xxhFinalize(h, p, end);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void XXHash64::reset(uint64_t seed)
+{
+    mySeed = seed;
+    myV[0] = seed + PRIME64_1 + PRIME64_2;
+    myV[1] = seed + PRIME64_2;
+    myV[2] = seed;
+    myV[3] = seed - PRIME64_1;
+    myLength = 0;
+    myBuffered = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void XXHash64::update(const void* data, size_t size)
+{
+    const byte* p = static_cast<const byte*>(data);
+    const byte* end = p + size;
+    myLength += size;
+
+    // Not enough for a stripe: keep the bytes for later.
+    if(myBuffered + size < 32)
+    {
+        if(size > 0) memcpy(myBuffer + myBuffered, p, size);
+        myBuffered += size;
+        return;
+    }
+
+    // Complete the buffered stripe.
+    if(myBuffered > 0)
+    {
+        size_t fill = 32 - myBuffered;
+        memcpy(myBuffer + myBuffered, p, fill);
+        myV[0] = xxhRound(myV[0], read64(myBuffer));
+        myV[1] = xxhRound(myV[1], read64(myBuffer + 8));
+        myV[2] = xxhRound(myV[2], read64(myBuffer + 16));
+        myV[3] = xxhRound(myV[3], read64(myBuffer + 24));
+        p += fill;
+        myBuffered = 0;
+    }
+
+    while(p + 32 <= end)
+    {
+        myV[0] = xxhRound(myV[0], read64(p)); p += 8;
+        myV[1] = xxhRound(myV[1], read64(p)); p += 8;
+        myV[2] = xxhRound(myV[2], read64(p)); p += 8;
+        myV[3] = xxhRound(myV[3], read64(p)); p += 8;
+    }
+
+    myBuffered = end - p;
+    if(myBuffered > 0) memcpy(myBuffer, p, myBuffered);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+uint64_t XXHash64::digest() const
+{
+    uint64_t h;
+    if(myLength >= 32)
+    {
+        h = rotl64(myV[0], 1) + rotl64(myV[1], 7) + rotl64(myV[2], 12) + rotl64(myV[3], 18);
+        h = xxhMergeRound(h, myV[0]);
+        h = xxhMergeRound(h, myV[1]);
+        h = xxhMergeRound(h, myV[2]);
+        h = xxhMergeRound(h, myV[3]);
+    }
+    else
+    {
+        h = mySeed + PRIME64_5;
+    }
+    h += myLength;
+    return xxhFinalize(h, myBuffer, myBuffer + myBuffered);
+}
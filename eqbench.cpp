@@ -0,0 +1,593 @@
+/******************************************************************************
+ * THE OMEGA LIB PROJECT
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2016		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2016, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file
+ *	A headless benchmark for the Equalizer display system. Runs the shared 
+ *  data commit / sync path between a master and a set of slave Collage nodes
+ *  living in the same process (connected through the loopback interface), 
+ *  shares synthetic input events and times the generation of the Equalizer 
+ *  configuration and the window input path. Nothing is rendered, so this 
+ *  runs on GPU-less machines.
+ *  The shared data path is driven through SharedData and the Collage nodes
+ *  directly, not through ConfigImpl / NodeImpl, so the Equalizer frame
+ *  synchronization (frame start / finish, swap barriers) and the server 
+ *  update are not part of the measured times.
+ *
+ *  Usage: eqbench [--nodes N] [--tiles N] [--objects N] [--payload BYTES]
+ *                 [--events N] [--frames N] [--port N] [--profile FRAMES]
+ *                 [--threads N] [--input N] [--transport tcp|pipe]
+ *                 [--relay FANOUT]
+ *
+ *  --transport pipe connects the nodes through the named pipes used for 
+ *  nodes sharing a machine (namedPipeTransport, windows only), to compare
+ *  their per-frame sync latency with TCP loopback.
+ *  --relay distributes the shared data through a relay tree with the given
+ *  fanout (sharedDataRelayFanout). Compare the master commit time of 
+ *  --nodes 8 and 32 with --relay 0 and --relay 4. All nodes run in this 
+ *  process, so this measures the master send cost, not network contention.
+ *  --nodes and --tiles are limited by the node and tile capacity of the 
+ *  display configuration.
+ ******************************************************************************/
+#include "eqinternal.h"
+
+using namespace omega;
+using namespace co::base;
+using namespace std;
+
+// Capacity of the fixed node and tile arrays of the display configuration.
+static const int MaxBenchNodes = sizeof(((DisplayConfig*)0)->nodes) / sizeof(DisplayNodeConfig);
+static const int MaxBenchTiles = sizeof(((DisplayNodeConfig*)0)->tiles) / sizeof(DisplayTileConfig*);
+
+///////////////////////////////////////////////////////////////////////////////
+// Command line options
+struct BenchOptions
+{
+    int nodes;
+    int tilesPerNode;
+    int objects;
+    int payload;
+    int events;
+    int frames;
+    int port;
+    int profileInterval;
+    int threads;
+    int input;
+    String transport;
+    int relay;
+
+    BenchOptions(): nodes(4), tilesPerNode(2), objects(8), payload(64 * 1024),
+        events(16), frames(500), port(25000), profileInterval(0), threads(0),
+        input(64), transport("tcp"), relay(0) {}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// A shared object with a payload of configurable size. The payload changes
+// every frame, like the state of a typical omegalib module.
+class BenchObject: public SharedObject
+{
+public:
+    BenchObject(int size): myPayload(size), myFrame(0) {}
+
+    virtual void commitSharedData(SharedOStream& out)
+    {
+        if(!myPayload.empty()) myPayload[myFrame++ % myPayload.size()]++;
+        uint64_t size = myPayload.size();
+        out << size;
+        if(size > 0) out.write(&myPayload[0], size);
+    }
+
+    virtual void updateSharedData(SharedIStream& in)
+    {
+        uint64_t size;
+        in >> size;
+        myPayload.resize(size);
+        if(size > 0) in.read(&myPayload[0], size);
+    }
+
+private:
+    Vector<byte> myPayload;
+    uint64_t myFrame;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Shares a queue of input events the same way EventSharingModule does, and
+// 'dispatches' them on the receiving side.
+class BenchEventQueue: public SharedObject
+{
+public:
+    BenchEventQueue(): myDispatched(0) {}
+
+    void postEvents(int count, uint64_t frame)
+    {
+        for(int i = 0; i < count; i++)
+        {
+            Event evt;
+            evt.reset(Event::Move, Service::Pointer);
+            evt.setPosition((float)(frame % 1920), (float)(i % 1080));
+            myQueue.push_back(evt);
+        }
+    }
+
+    virtual void commitSharedData(SharedOStream& out)
+    {
+        int numEvents = myQueue.size();
+        out << numEvents;
+        foreach(const Event& evt, myQueue) out.write(&evt, sizeof(Event));
+        myQueue.clear();
+    }
+
+    virtual void updateSharedData(SharedIStream& in)
+    {
+        int numEvents;
+        in >> numEvents;
+        for(int i = 0; i < numEvents; i++)
+        {
+            Event evt;
+            in.read(&evt, sizeof(Event));
+            if(evt.getType() == Event::Move) myDispatched++;
+        }
+    }
+
+    uint64_t getDispatched() { return myDispatched; }
+
+private:
+    List<Event> myQueue;
+    uint64_t myDispatched;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Accumulates timing samples for one phase of the frame.
+struct PhaseStat
+{
+    double total;
+    double min;
+    double max;
+    int samples;
+
+    PhaseStat(): total(0), min(1e9), max(0), samples(0) {}
+    void add(double ms) 
+    { 
+        total += ms; samples++;
+        if(ms < min) min = ms;
+        if(ms > max) max = ms;
+    }
+    void print(const char* name)
+    {
+        if(samples == 0) return;
+        printf("  %-16s avg %8.3f ms   min %8.3f ms   max %8.3f ms\n", 
+            name, total / samples, min, max);
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+void printUsage()
+{
+    printf("Usage: eqbench [--nodes N] [--tiles N] [--objects N] [--payload BYTES]\n"
+        "               [--events N] [--frames N] [--port N] [--profile FRAMES]\n"
+        "               [--threads N] [--input N] [--transport tcp|pipe]\n"
+        "               [--relay FANOUT]\n");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool parseOptions(int argc, char** argv, BenchOptions& opts)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        String arg = argv[i];
+        if(arg == "--help" || arg == "-h")
+        {
+            printUsage();
+            return false;
+        }
+        if(i + 1 >= argc)
+        {
+            printf("eqbench: missing value for %s\n", argv[i]);
+            return false;
+        }
+        if(arg == "--transport")
+        {
+            opts.transport = argv[++i];
+            if(opts.transport != "tcp" && opts.transport != "pipe")
+            {
+                printf("eqbench: unknown transport %s\n", opts.transport.c_str());
+                return false;
+            }
+            continue;
+        }
+        int value = atoi(argv[++i]);
+        if(arg == "--nodes") opts.nodes = max(1, value);
+        else if(arg == "--tiles") opts.tilesPerNode = max(1, value);
+        else if(arg == "--objects") opts.objects = max(0, value);
+        else if(arg == "--payload") opts.payload = max(0, value);
+        else if(arg == "--events") opts.events = max(0, value);
+        else if(arg == "--frames") opts.frames = max(1, value);
+        else if(arg == "--port") opts.port = value;
+        else if(arg == "--profile") opts.profileInterval = max(0, value);
+        else if(arg == "--threads") opts.threads = max(0, value);
+        else if(arg == "--input") opts.input = max(0, value);
+        else if(arg == "--relay") opts.relay = max(0, value);
+        else
+        {
+            printf("eqbench: unknown option %s\n", arg.c_str());
+            printUsage();
+            return false;
+        }
+    }
+    if(opts.nodes > MaxBenchNodes || opts.tilesPerNode > MaxBenchTiles)
+    {
+        printf("eqbench: at most %d nodes and %d tiles per node\n", MaxBenchNodes, MaxBenchTiles);
+        printUsage();
+        return false;
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Builds a display configuration for the requested node / tile counts and
+// times the generation of the Equalizer configuration from it.
+void benchmarkConfigGeneration(const BenchOptions& opts)
+{
+    EqualizerDisplaySystem ds;
+    DisplayConfig& dc = ds.getDisplayConfig();
+    dc.disableConfigGenerator = true;
+    dc.numNodes = opts.nodes;
+    for(int n = 0; n < opts.nodes; n++)
+    {
+        DisplayNodeConfig& nc = dc.nodes[n];
+        nc.hostname = n == 0 ? "local" : ostr("node%1%", %n);
+        nc.port = n;
+        nc.isRemote = n > 0;
+        nc.enabled = true;
+        nc.numTiles = opts.tilesPerNode;
+        for(int t = 0; t < opts.tilesPerNode; t++)
+        {
+            DisplayTileConfig* tc = new DisplayTileConfig(dc);
+            tc->name = ostr("t%1%x%2%", %n %t);
+            tc->device = t;
+            tc->pixelSize = Vector2i(1920, 1080);
+            tc->position = Vector2i(t * 1920, 0);
+            tc->node = &nc;
+            tc->enabled = true;
+            nc.tiles[t] = tc;
+            dc.tiles[tc->name] = tc;
+        }
+    }
+
+    Timer timer;
+    timer.start();
+    String cfg = ds.generateEqConfig();
+    double ms = timer.getElapsedTimeInMilliSec();
+    printf("Config generation: %d nodes x %d tiles, %d bytes in %.3f ms\n", 
+        opts.nodes, opts.tilesPerNode, (int)cfg.size(), ms);
+
+    dc.tiles.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Writes a pointer event the way the window input path does.
+void writePointerEvent(Event& evt, Event::Type type, int x, int y)
+{
+    evt.reset(type, Service::Pointer);
+    evt.setPosition(x, y);
+    evt.setExtraDataType(Event::ExtraDataVector3Array);
+    evt.setExtraDataVector3(0, Vector3f::Zero());
+    evt.setExtraDataVector3(1, -Vector3f::UnitZ());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Runs a burst of window input (mouse motion with a button press in the 
+// middle) through the input record queue, and expands it once per frame.
+// Returns the number of events expanded. Like ConfigImpl::queueInput, each
+// sample takes the event queue lock to read the event count.
+uint64_t runInputRecords(const BenchOptions& opts, bool coalesce, Vector<Event>& ring, omicron::Lock& eventLock)
+{
+    int burst = opts.input;
+    InputQueue queue;
+    queue.setCoalesceMotion(coalesce);
+    uint64_t expanded = 0;
+    for(int frame = 0; frame < opts.frames; frame++)
+    {
+        for(int i = 0; i < burst; i++)
+        {
+            InputRecord r;
+            r.kind = (i == burst / 2) ? InputRecord::PointerButton : InputRecord::PointerMotion;
+            r.type = 1;
+            r.code = 0;
+            r.x = i;
+            r.y = frame;
+            r.wheel = 0;
+            r.time = FrameClock::now();
+            eventLock.lock();
+            r.eventIndex = 0;
+            queue.push(r);
+            eventLock.unlock();
+        }
+        eventLock.lock();
+        InputRecord r;
+        int n = 0;
+        while(queue.pop(r))
+        {
+            Event::Type type = r.kind == InputRecord::PointerButton ? Event::Down : Event::Move;
+            writePointerEvent(ring[n++], type, r.x, r.y);
+        }
+        eventLock.unlock();
+        expanded += n;
+    }
+    return expanded;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Compares the cost of a burst of window input written as one full event 
+// per sample (each taking the event queue lock, as the window callbacks 
+// did), with the same burst queued as input records and expanded once per
+// frame, with and without motion coalescing. Only the uncoalesced record 
+// path delivers the same events as the full event path.
+void benchmarkInputPath(const BenchOptions& opts)
+{
+    int burst = opts.input;
+    // Emulates the service manager event ring and its lock.
+    Vector<Event> ring(burst);
+    omicron::Lock eventLock;
+
+    Timer timer;
+    timer.start();
+
+    double t0 = timer.getElapsedTimeInMilliSec();
+    for(int frame = 0; frame < opts.frames; frame++)
+    {
+        for(int i = 0; i < burst; i++)
+        {
+            Event::Type type = (i == burst / 2) ? Event::Down : Event::Move;
+            eventLock.lock();
+            writePointerEvent(ring[i], type, i, frame);
+            eventLock.unlock();
+        }
+    }
+    double t1 = timer.getElapsedTimeInMilliSec();
+    uint64_t expanded = runInputRecords(opts, false, ring, eventLock);
+    double t2 = timer.getElapsedTimeInMilliSec();
+    uint64_t coalesced = runInputRecords(opts, true, ring, eventLock);
+    double t3 = timer.getElapsedTimeInMilliSec();
+
+    printf("Input path: %d samples/frame (Event = %d bytes, InputRecord = %d bytes)\n",
+        burst, (int)sizeof(Event), (int)sizeof(InputRecord));
+    printf("  full events        %8.3f us/frame  %6d events/frame\n",
+        (t1 - t0) * 1000 / opts.frames, burst);
+    printf("  input records      %8.3f us/frame  %6d events/frame\n",
+        (t2 - t1) * 1000 / opts.frames, (int)(expanded / opts.frames));
+    printf("  coalesced records  %8.3f us/frame  %6d events/frame\n",
+        (t3 - t2) * 1000 / opts.frames, (int)(coalesced / opts.frames));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+co::ConnectionDescriptionPtr createConnectionDescription(const BenchOptions& opts, int port)
+{
+    if(opts.transport == "pipe") return createNamedPipeConnectionDescription("local", port);
+
+    co::ConnectionDescriptionPtr desc = new co::ConnectionDescription;
+    desc->type = co::CONNECTIONTYPE_TCPIP;
+    desc->port = port;
+    desc->setHostname("localhost");
+    return desc;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    BenchOptions opts;
+    if(!parseOptions(argc, argv, opts)) return 1;
+
+    if(!co::init(argc, argv))
+    {
+        printf("eqbench: Collage initialization failed\n");
+        return 1;
+    }
+
+    printf("eqbench: %d nodes, %d tiles/node, %d objects x %d bytes, %d events/frame, %d frames, %d serialization threads, %s transport, relay fanout %d\n",
+        opts.nodes, opts.tilesPerNode, opts.objects, opts.payload, opts.events, opts.frames, opts.threads, opts.transport.c_str(), opts.relay);
+    if(opts.transport == "pipe" && createNamedPipeConnectionDescription("local", opts.port) == NULL)
+    {
+        printf("eqbench: named pipes are only supported on windows\n");
+        return 1;
+    }
+
+    benchmarkConfigGeneration(opts);
+    if(opts.input > 0) benchmarkInputPath(opts);
+
+    // Master node
+    co::LocalNodePtr master = new co::LocalNode;
+    co::ConnectionDescriptionPtr masterDesc = createConnectionDescription(opts, opts.port);
+    master->addConnectionDescription(masterDesc);
+    if(!master->listen())
+    {
+        printf("eqbench: master could not listen on port %d\n", opts.port);
+        return 1;
+    }
+
+    // The master node uses the first node slot: the remaining ones are slaves.
+    int numSlaves = opts.nodes - 1;
+    Vector<co::LocalNodePtr> slaves;
+    Vector<SharedData*> slaveData;
+    Vector<SharedObject*> objects;
+
+    SharedData masterData;
+    if(opts.profileInterval > 0) masterData.setProfilingEnabled(true, opts.profileInterval);
+    if(opts.threads > 0)
+    {
+        // All benchmark objects are safe to serialize concurrently.
+        Vector<String> parallelIds;
+        parallelIds.push_back("*");
+        masterData.setParallelSerialization(opts.threads, parallelIds);
+    }
+    BenchEventQueue* masterEvents = new BenchEventQueue();
+    masterData.registerObject(masterEvents, "events");
+    objects.push_back(masterEvents);
+    for(int i = 0; i < opts.objects; i++)
+    {
+        BenchObject* obj = new BenchObject(opts.payload);
+        masterData.registerObject(obj, ostr("object%1%", %i));
+        objects.push_back(obj);
+    }
+    master->registerObject(&masterData);
+
+    // Relay tree, built like EqualizerDisplaySystem::buildRelayTree: slave n
+    // receives the shared data from slave n / fanout - 1, or the master.
+    Vector<int> relayParent(numSlaves, -1);
+    Vector<SharedDataRelay*> relays(numSlaves, (SharedDataRelay*)NULL);
+    if(opts.relay > 0)
+    {
+        for(int n = opts.relay; n < numSlaves; n++) relayParent[n] = n / opts.relay - 1;
+    }
+
+    Vector<BenchEventQueue*> slaveEvents;
+    for(int n = 0; n < numSlaves; n++)
+    {
+        co::LocalNodePtr slave = new co::LocalNode;
+        slave->addConnectionDescription(createConnectionDescription(opts, opts.port + n + 1));
+        co::NodePtr parentProxy = new co::Node;
+        int parent = relayParent[n];
+        if(parent < 0) parentProxy->addConnectionDescription(masterDesc);
+        else parentProxy->addConnectionDescription(createConnectionDescription(opts, opts.port + parent + 1));
+        if(!slave->listen() || !slave->connect(parentProxy))
+        {
+            printf("eqbench: slave %d could not connect to its parent\n", n);
+            return 1;
+        }
+
+        SharedData* data = new SharedData();
+        bool hasChildren = false;
+        for(int c = n + 1; c < numSlaves; c++) if(relayParent[c] == n) hasChildren = true;
+        if(hasChildren)
+        {
+            relays[n] = new SharedDataRelay(data);
+            data->setRelay(relays[n]);
+        }
+        if(opts.profileInterval > 0) data->setProfilingEnabled(true, opts.profileInterval);
+        BenchEventQueue* evts = new BenchEventQueue();
+        data->registerObject(evts, "events");
+        slaveEvents.push_back(evts);
+        objects.push_back(evts);
+        for(int i = 0; i < opts.objects; i++)
+        {
+            BenchObject* obj = new BenchObject(opts.payload);
+            data->registerObject(obj, ostr("object%1%", %i));
+            objects.push_back(obj);
+        }
+        co::base::UUID id = parent < 0 ? 
+            masterData.getID() : SharedDataRelay::getRelayID(ostr("slave%1%", %parent));
+        if(!slave->mapObject(data, id))
+        {
+            printf("eqbench: slave %d could not map the shared data\n", n);
+            return 1;
+        }
+        if(relays[n] != NULL)
+        {
+            relays[n]->setID(SharedDataRelay::getRelayID(ostr("slave%1%", %n)));
+            slave->registerObject(relays[n]);
+        }
+        slaves.push_back(slave);
+        slaveData.push_back(data);
+    }
+
+    PhaseStat eventStat;
+    PhaseStat commitStat;
+    PhaseStat syncStat;
+    PhaseStat frameStat;
+    uint64_t totalBytes = 0;
+
+    Timer timer;
+    timer.start();
+    double start = timer.getElapsedTimeInMilliSec();
+    for(int frame = 0; frame < opts.frames; frame++)
+    {
+        double t0 = timer.getElapsedTimeInMilliSec();
+
+        UpdateContext uc;
+        uc.frameNum = frame;
+        uc.dt = 1.0f / 60;
+        uc.time = frame * uc.dt;
+        masterData.setUpdateContext(uc);
+        masterEvents->postEvents(opts.events, frame);
+        double t1 = timer.getElapsedTimeInMilliSec();
+
+        masterData.commit();
+        totalBytes += masterData.getLastFrameSize();
+        double t2 = timer.getElapsedTimeInMilliSec();
+
+        // Slaves receive and apply the new version (the same thing 
+        // ConfigImpl::updateSharedData does in NodeImpl::frameStart). 
+        // Parents come before their children, so relays forward each version
+        // before their children wait for it.
+        for(int n = 0; n < numSlaves; n++)
+        {
+            slaveData[n]->sync(co::VERSION_NEXT);
+            if(relays[n] != NULL) relays[n]->commit();
+        }
+        double t3 = timer.getElapsedTimeInMilliSec();
+
+        eventStat.add(t1 - t0);
+        commitStat.add(t2 - t1);
+        if(numSlaves > 0) syncStat.add((t3 - t2) / numSlaves);
+        frameStat.add(t3 - t0);
+    }
+    double elapsed = timer.getElapsedTimeInMilliSec() - start;
+
+    printf("Frames/sec: %.1f\n", opts.frames * 1000.0 / elapsed);
+    printf("Bytes/frame: %d\n", (int)(totalBytes / opts.frames));
+    printf("Per-phase latency:\n");
+    eventStat.print("events");
+    commitStat.print("commit");
+    syncStat.print("sync (per node)");
+    frameStat.print("frame");
+    if(numSlaves > 0)
+    {
+        printf("Events dispatched per slave: %d\n", (int)slaveEvents[0]->getDispatched());
+    }
+
+    // Children first: they are mapped to the relays of their parents.
+    for(int n = numSlaves - 1; n >= 0; n--)
+    {
+        slaves[n]->unmapObject(slaveData[n]);
+        if(relays[n] != NULL)
+        {
+            slaves[n]->deregisterObject(relays[n]);
+            delete relays[n];
+        }
+        slaves[n]->close();
+        delete slaveData[n];
+    }
+    master->deregisterObject(&masterData);
+    master->close();
+    foreach(SharedObject* obj, objects) delete obj;
+
+    co::exit();
+    return 0;
+}
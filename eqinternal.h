@@ -47,6 +47,9 @@
 // Equalizer includes
 #include "eq/eq.h"
 #include "co/co.h"
+#include "co/base/monitor.h"
+#include "co/base/mtQueue.h"
+#include "co/base/thread.h"
 
 // Define to enable debugging of equalizer flow.
 //#define OMEGA_DEBUG_EQ_FLOW
@@ -65,12 +68,194 @@ namespace omega {
     class RenderTarget;
     class Camera;
 
+//! @internal Reads a list of strings from a configuration setting. Returns
+//! an empty list if the setting does not exist.
+Vector<String> getStringList(const String& name, Setting& s);
+
+//! @internal Returns true if the two hostnames resolve to the same machine.
+//! The "local" hostname and loopback addresses refer to this machine.
+bool isSameHost(const String& a, const String& b);
+
+//! @internal Returns the description of the named pipe of the Collage node
+//! listening on the given host and port. Collage only implements named 
+//! pipes on windows: returns NULL on other platforms.
+co::ConnectionDescriptionPtr createNamedPipeConnectionDescription(const String& hostname, int port);
+
+//! @internal Computes the 64-bit xxHash (XXH64) of a block of memory.
+uint64_t xxhash64(const void* data, size_t size, uint64_t seed = 0);
+
+//! @internal Incremental XXH64: hashing data in any number of pieces gives
+//! the same result as xxhash64 over all of it.
+class XXHash64
+{
+public:
+    XXHash64(uint64_t seed = 0) { reset(seed); }
+    void reset(uint64_t seed = 0);
+    void update(const void* data, size_t size);
+    uint64_t digest() const;
+
+private:
+    uint64_t myV[4];
+    uint64_t mySeed;
+    uint64_t myLength;
+    byte myBuffer[32];
+    size_t myBuffered;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! @internal
+//! A unit of work executed by a WorkerPool thread.
+class WorkerTask
+{
+public:
+    virtual ~WorkerTask() {}
+    virtual void execute() = 0;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! @internal
+//! Tracks completion of a set of tasks submitted to a WorkerPool, so they can
+//! be joined independently of other tasks running on the same pool.
+class WorkerTaskGroup
+{
+public:
+    WorkerTaskGroup(): myPendingTasks(0) {}
+    //! Blocks until all tasks submitted with this group have been executed.
+    void wait() { myPendingTasks.waitEQ(0); }
+    bool isDone() { return myPendingTasks.get() == 0; }
+
+private:
+    friend class WorkerPool;
+    co::base::Monitor<int> myPendingTasks;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! @internal
+//! A fixed set of worker threads executing WorkerTasks. Tasks are submitted
+//! from a single thread, which then calls wait() to join them.
+class WorkerPool
+{
+public:
+    WorkerPool(int numThreads);
+    ~WorkerPool();
+
+    int getNumThreads() { return myWorkers.size(); }
+    //! Queues a task. If group is NULL, the task is added to the default 
+    //! group joined by wait()
+    void submit(WorkerTask* task, WorkerTaskGroup* group = NULL);
+    //! Blocks until all tasks submitted to the default group have been executed.
+    void wait() { myDefaultGroup.wait(); }
+
+private:
+    class Worker: public co::base::Thread
+    {
+    public:
+        Worker(WorkerPool* pool): myPool(pool) {}
+        virtual void run();
+    private:
+        WorkerPool* myPool;
+    };
+
+    struct QueuedTask
+    {
+        WorkerTask* task;
+        WorkerTaskGroup* group;
+    };
+
+    Vector<Worker*> myWorkers;
+    co::base::MTQueue<QueuedTask> myQueue;
+    WorkerTaskGroup myDefaultGroup;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! @internal
+//! A shared input stream reading from a memory buffer.
+class BufferSharedIStream: public SharedIStream
+{
+public:
+    BufferSharedIStream(const Vector<byte>* buffer) : myBuffer(buffer), myPosition(0) {}
+    SharedIStream& operator >> (String& str);
+    void read(void* data, uint64_t size);
+private:
+    const Vector<byte>* myBuffer;
+    uint64_t myPosition;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! @internal
+//! A shared output stream writing to a memory buffer. The buffer keeps its 
+//! capacity when cleared, so reusing it every frame does not reallocate.
+class BufferSharedOStream: public SharedOStream
+{
+public:
+    BufferSharedOStream(Vector<byte>* buffer) : myBuffer(buffer) {}
+    SharedOStream& operator << (const String& str);
+    void write(const void* data, uint64_t size);
+private:
+    Vector<byte>* myBuffer;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! @internal
+//! A shared object registered with SharedData, plus its scratch buffer and
+//! profiling counters.
+class SharedObjectEntry: public ReferenceType
+{
+public:
+    enum ApplyMode 
+    { 
+        // Applied on the main thread, in stream order.
+        ApplyImmediate, 
+        // Applied on a worker thread, joined before Engine::update.
+        ApplyParallel, 
+        // Applied on a worker thread, joined before the next update is applied.
+        ApplyDeferred 
+    };
+
+    SharedObjectEntry(SharedObject* obj): 
+        object(obj), parallel(false), filtered(false), applyMode(ApplyImmediate), lastTime(0),
+        lastBytes(0), totalBytes(0), totalTime(0), frames(0) {}
+
+    SharedObject* object;
+
+    // When true, the object is serialized on a worker thread (master).
+    bool parallel;
+    // When true, the object has an interest set: it is serialized with the
+    // other objects but only written to the node lanes of interested nodes.
+    bool filtered;
+    // How updates to this object are applied (slaves).
+    ApplyMode applyMode;
+    // Serialized object data for the current frame.
+    Vector<byte> buffer;
+    // Time spent serializing / applying the object in the current frame, in ms.
+    double lastTime;
+
+    // Profiling (see SharedData::setProfilingEnabled). Totals are reset after
+    // each periodic report.
+    uint64_t lastBytes;
+    uint64_t totalBytes;
+    double totalTime;
+    int frames;
+    Ref<Stat> bytesStat;
+    Ref<Stat> timeStat;
+};
+
+class SharedDataRelay;
+class SharedDataRecording;
+class EqualizerSharedIStream;
+class EqualizerSharedOStream;
+
 ///////////////////////////////////////////////////////////////////////////////
 class SharedData: public co::Object, public ISharedData
 {
 public:
+    SharedData();
+    virtual ~SharedData();
+    void setup(Setting& s);
     void registerObject(SharedObject* object, const String& id);
     void unregisterObject(const String& id);
+    //! Drops all registered objects and pending data (slaves, after unmapping).
+    void clearObjects();
     // The shared data is unbuffered: we do not store multiple versions of it.
     // This reduces the memory footprint of large serialized objects (like
     // the frames generated by the omegaToolkit::ImageBroadcastModule)
@@ -78,41 +263,748 @@ public:
     // HINT: to support frame latencym change this to INSTANCE, and modify
     // setAutoObsolete to be = to latency, or more.
     virtual ChangeType getChangeType() const { return UNBUFFERED; }
+    //! Serializes buffered objects and updates change tracking before 
+    //! committing, since pack only runs when nodes mapped the shared data.
+    virtual uint128_t commit(const uint32_t incarnation = CO_COMMIT_NEXT);
     void setUpdateContext(const UpdateContext& ctx) { myUpdateContext = ctx; }
     const UpdateContext& getUpdateContext() { return myUpdateContext; }
+    //! Master frame clock time, in microseconds. Broadcast together with the
+    //! update context, whose time is only single precision: this is the 
+    //! same time, without the float quantization.
+    void setFrameTime(uint64_t timeUs) { myFrameTime = timeUs; }
+    uint64_t getFrameTime() { return myFrameTime; }
+
+    //! Size in bytes of the last version serialized (master) or applied (slaves)
+    uint64_t getLastFrameSize() { return myLastFrameSize; }
+
+    //! Per-object profiling: when enabled, bytes and time spent in 
+    //! commitSharedData (master) or updateSharedData (slaves) are tracked for
+    //! each object, exposed as stats and periodically logged for the
+    //! reportCount most expensive objects. A reportInterval of 0 disables the 
+    //! periodic report.
+    void setProfilingEnabled(bool enabled, int reportInterval = 0, int reportCount = 5);
+    bool isProfilingEnabled() { return myProfilingEnabled; }
+
+    //! Parallel serialization: objects whose id is in the parallelIds list 
+    //! (or all objects, if the list contains "*") are serialized concurrently
+    //! on a pool of numThreads workers. Objects are always written to the 
+    //! stream in the same order. numThreads = 0 disables parallel 
+    //! serialization. Only objects whose commitSharedData is thread-safe 
+    //! with respect to the rest of the application should be listed.
+    void setParallelSerialization(int numThreads, const Vector<String>& parallelIds);
+
+    //! Parallel and deferred application on slave nodes. Updates to objects 
+    //! in parallelIds are applied on the worker pool while the other objects
+    //! are applied on the main thread, and are joined before the update 
+    //! returns. Updates to objects in deferredIds are applied on the worker
+    //! pool and joined before the next update is applied (or by finishApply),
+    //! so they overlap rendering: these objects must synchronize access to
+    //! their own state. Has no effect unless parallel serialization is 
+    //! enabled with a nonzero thread count.
+    void setParallelApply(const Vector<String>& parallelIds, const Vector<String>& deferredIds);
+    //! Waits for all deferred object updates to be applied.
+    void finishApply();
+
+    //! When no object is serialized in parallel and no other feature needs
+    //! the serialized object data, objects are written straight to the 
+    //! commit stream, without a size prefix. Buffered mode keeps a copy of 
+    //! each object in its own buffer: it is needed by snapshots for nodes 
+    //! joining a running session and by recordings, which are built from 
+    //! the last committed version.
+    void setBuffered(bool buffered) { myBuffered = buffered; }
 
+    //! Change tracking (master): when enabled, a hash of all object data is
+    //! computed at each commit (with or without nodes mapping the shared 
+    //! data), and hasChanged() tells whether the last commit differed from
+    //! the one before it. The update context is not 
+    //! included, so a frame where only time advanced counts as unchanged.
+    void setChangeTrackingEnabled(bool enabled);
+    //! Also true while progressive transfers are pending, and when the bulk
+    //! lane changed.
+    bool hasChanged();
+
+    //! Divergence detection. When enabled, the bytes of each version are 
+    //! hashed as they are packed (master) or applied (slaves): matching 
+    //! hashes mean a node applied exactly what the master sent. Snapshots
+    //! are not hashed.
+    void setDivergenceCheckEnabled(bool enabled) { myDivergenceCheck = enabled; }
+    uint64_t getStreamHash() { return myStreamHash; }
+    //! Hashes the current state of the given objects, as serialized by 
+    //! their commitSharedData. Their commitSharedData must not have side
+    //! effects.
+    uint64_t hashObjects(const Vector<String>& ids);
+
+    //! Input latency tracking. On the master, setInputTime is called right
+    //! before commit with the local time at which the oldest input event 
+    //! handled in this frame was ingested (0 if there was none). The age of
+    //! that input is broadcast with the update context. getLocalFrameTime 
+    //! returns the local time at which this frame was committed (master) or 
+    //! received (slaves): nodes add their own delay from that point to the
+    //! input age. The time a version spends in transit is measured on the 
+    //! Equalizer config clock, which the server synchronizes on all nodes:
+    //! the master stamps each version with setCommitClock, and slaves pass
+    //! the transit time to addTransitTime, which moves their local frame 
+    //! time back. The config clock has a 1ms resolution.
+    static const uint64_t NoInput = (uint64_t)-1;
+    void setInputTime(uint64_t timeUs);
+    //! Config clock time (ms) at which this version is committed (master).
+    void setCommitClock(int64_t timeMs) { myCommitClock = timeMs; }
+    int64_t getCommitClock() { return myCommitClock; }
+    void addTransitTime(uint64_t timeUs) { myLocalFrameTime -= min(timeUs, myLocalFrameTime); }
+    //! Age of the input handled in this frame, or NoInput.
+    uint64_t getInputAge() { return myInputAge; }
+    uint64_t getLocalFrameTime() { return myLocalFrameTime; }
+
+    //! Progressive transfers (see EqualizerDisplaySystem::sendSharedStream).
+    //! sendStream can be called from any thread on the master.
+    void sendStream(const String& streamId, const void* data, uint64_t size);
+    //! Maximum number of stream bytes sent in one frame, for all transfers.
+    void setStreamBudget(uint64_t bytesPerFrame) { myStreamBudget = bytesPerFrame; }
+    void addStreamListener(SharedStreamListener* listener);
+    void removeStreamListener(SharedStreamListener* listener);
+
+    //! Lanes (see EqualizerDisplaySystem::setSharedObjectLane). The priority
+    //! lane is the SharedData registered with SharedDataServices: objects 
+    //! declared as bulk, and progressive transfers, are forwarded to the 
+    //! bulk lane if there is one. The bulk lane id is part of the priority 
+    //! lane snapshot, so joining nodes can map it.
+    enum Lane { PriorityLane, BulkLane };
+    void setBulkLane(SharedData* bulk) { myBulkLane = bulk; }
+    SharedData* getBulkLane() { return myBulkLane; }
+    //! Id of the bulk lane, received with the snapshot (slaves).
+    const co::base::UUID& getBulkLaneID() { return myBulkLaneID; }
+    //! Only affects objects registered after the call.
+    void setObjectLane(const String& id, Lane lane);
+    Lane getObjectLane(const String& id);
+
+    //! Interest filtering (see EqualizerDisplaySystem::setSharedObjectInterest).
+    //! Each remote node has a node lane, mapped only by that node. On the 
+    //! master, objects with an interest set are serialized once by this 
+    //! lane and written to the node lanes of the interested nodes only. On
+    //! slaves, they are registered with the local node lane if this node is
+    //! interested, and not at all otherwise. Nodes are identified by their 
+    //! hostname:port key.
+    //@{
+    void addNodeLane(const String& node, SharedData* lane);
+    //! Slaves: key of this node. Empty on the master.
+    void setLocalNode(const String& node) { myLocalNode = node; }
+    //! Only affects objects registered after the call.
+    void setObjectInterest(const String& id, const Vector<String>& nodes);
+    //! Node lane ids, received with the snapshot (slaves).
+    const Dictionary<String, co::base::UUID>& getNodeLaneIDs() { return myNodeLaneIDs; }
+    //! Master node lanes: the lane writes the buffers of source objects 
+    //! instead of serializing objects itself.
+    void setSource(SharedData* source) { mySource = source; }
+    //@}
+
+    //! Relay (slaves): every version received is forwarded unchanged to the
+    //! relay, which re-commits it to the children of this node.
+    void setRelay(SharedDataRelay* relay) { myRelay = relay; }
+
+    //! Recording and replay (see SharedDataRecording).
+    //@{
+    //! Appends the last committed version to the recording. Called after 
+    //! commit, in buffered mode (see setBuffered).
+    void recordFrame(SharedDataRecording* recording);
+    //! Applies a recorded version, as sync would. The first version of a 
+    //! recording is applied as a snapshot.
+    void applyRecordedFrame(const byte* data, uint64_t size, bool snapshot);
+    //@}
 
 protected:
+    //! Snapshot sent to / received by nodes mapping the shared data.
     virtual void getInstanceData( co::DataOStream& os );
     virtual void applyInstanceData( co::DataIStream& is );
+    //! Per-frame data sent at each commit / applied at each sync.
+    virtual void pack( co::DataOStream& os );
+    virtual void unpack( co::DataIStream& is );
+
+private:
+    bool isBuffered();
+    void serializeObjects();
+    //! Writes the object buffers (buffered mode and snapshots).
+    void writeObjects(SharedOStream& out);
+    void writeObjectsDirect(EqualizerSharedOStream& eos);
+    void applyObjects(EqualizerSharedIStream& eis, bool snapshot);
+    bool isParallelObject(const String& id);
+    SharedObjectEntry::ApplyMode getApplyMode(const String& id);
+    void joinApplyTasks(WorkerTaskGroup& group, List<WorkerTask*>& tasks);
+    void profileObject(const String& id, SharedObjectEntry* entry, uint64_t bytes, double time);
+    void reportProfile();
+    //! Starts queued transfers and picks the stream chunks of this version.
+    void advanceStreams();
+    //! Writes the stream chunks for this version. Snapshots carry no chunks.
+    void writeStreams(SharedOStream& out, bool commit);
+    void applyStreams(SharedIStream& in);
+    void notifyStreamCompleted(const String& streamId, const Vector<byte>& data);
+    //! Adds an object already registered (and serialized) by the source lane.
+    void attachEntry(const String& id, SharedObjectEntry* entry);
+    //! Adds a registered object. Called with myLock held. Returns true and 
+    //! moves the pending snapshot of the object to snapshot if there is one.
+    bool addEntry(const String& id, SharedObjectEntry* entry, Vector<byte>& snapshot);
+    //! Applies registrations and unregistrations queued while packing.
+    void applyPendingRegistrations();
+    void setPacking(bool packing);
 
 private:
-    Dictionary<String, SharedObject*> myObjects;
-    List<String> myObjectsToUnregister;
-    typedef Dictionary<String, SharedObject*>::Item SharedObjectItem;
+    //! A queued registration. A NULL entry unregisters the object.
+    struct PendingRegistration
+    {
+        String id;
+        Ref<SharedObjectEntry> entry;
+    };
+
+    struct StreamTransfer
+    {
+        String id;
+        Vector<byte> data;
+        // Bytes sent (master) or received (slaves) so far.
+        uint64_t offset;
+    };
+    struct StreamChunk
+    {
+        StreamTransfer* transfer;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+private:
+    Dictionary<String, Ref<SharedObjectEntry> > myObjects;
+    typedef Dictionary<String, Ref<SharedObjectEntry> >::Item SharedObjectItem;
     UpdateContext myUpdateContext;
+    uint64_t myFrameTime;
+    uint64_t myLastFrameSize;
+    uint64_t myInputAge;
+    uint64_t myLocalFrameTime;
+    int64_t myCommitClock;
+
+    // Profiling
+    bool myProfilingEnabled;
+    int myReportInterval;
+    int myReportCount;
+    int myFramesSinceReport;
+    Timer myTimer;
+
+    // Parallel serialization
+    WorkerPool* myWorkerPool;
+    Vector<String> myParallelIds;
+
+    // Parallel / deferred application
+    Vector<String> myParallelApplyIds;
+    Vector<String> myDeferredApplyIds;
+    WorkerTaskGroup myParallelApplyGroup;
+    WorkerTaskGroup myDeferredApplyGroup;
+    List<WorkerTask*> myParallelApplyTasks;
+    List<WorkerTask*> myDeferredApplyTasks;
+
+    // Change tracking
+    bool myChangeTrackingEnabled;
+    uint64_t myContentHash;
+    uint64_t myPreviousContentHash;
+
+    // Late join. The lock protects the object list and buffers from 
+    // snapshots taken on the Collage command thread.
+    omicron::Lock myLock;
+    bool myHasCommitted;
+    // Objects register and unregister others while they are serialized, 
+    // possibly from worker threads. While packing (myPacking, protected by
+    // myQueueLock) registrations are queued and applied at the next commit
+    // (master) or sync (slaves). Unregistrations are always queued.
+    omicron::Lock myQueueLock;
+    bool myPacking;
+    List<PendingRegistration> myPendingRegistrations;
+    Dictionary<String, Vector<byte> > myPendingSnapshots;
+
+    // Lanes
+    SharedData* myBulkLane;
+    co::base::UUID myBulkLaneID;
+    Vector<String> myBulkIds;
+    Dictionary<String, SharedData*> myNodeLanes;
+    Dictionary<String, co::base::UUID> myNodeLaneIDs;
+    Dictionary<String, Vector<String> > myInterests;
+    String myLocalNode;
+    SharedData* mySource;
+
+    // Relay
+    SharedDataRelay* myRelay;
+    Vector<byte> myRelayBuffer;
+
+    // Divergence detection
+    bool myDivergenceCheck;
+    uint64_t myStreamHash;
+    Vector<byte> myHashBuffer;
+
+    // Recording
+    bool myBuffered;
+    Vector<byte> myRecordBuffer;
+
+    // Progressive transfers. New transfers are queued (myQueueLock) and 
+    // start at the next commit. Outgoing transfers are protected by myLock.
+    uint64_t myStreamBudget;
+    List<StreamTransfer*> myQueuedStreams;
+    List<StreamTransfer*> myOutgoingStreams;
+    // Chunks of the version being committed.
+    Vector<StreamChunk> myStreamChunks;
+    // Transfers whose last chunk was committed: listeners are notified 
+    // after commit releases the lock.
+    List<StreamTransfer*> myCompletedStreams;
+    Dictionary<String, StreamTransfer*> myIncomingStreams;
+    List< Ref<SharedStreamListener> > myStreamListeners;
+    Ref<Stat> myStreamBytesStat;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! @internal
+//! A node of the shared data relay tree. Relay nodes receive the shared data
+//! from their parent (the master or another relay) and commit each version,
+//! unchanged, to their children through this object, so the master only 
+//! sends to its direct children. Children map the relay instead of the 
+//! master shared data: the stream format is the same. Relay ids are derived
+//! from the node key, so children can find their parent relay without a 
+//! directory.
+class SharedDataRelay: public co::Object
+{
+public:
+    //! Returns the id of the relay object of the given node.
+    static co::base::UUID getRelayID(const String& nodeKey);
+
+public:
+    SharedDataRelay(SharedData* source);
+    virtual ChangeType getChangeType() const { return UNBUFFERED; }
+    //! Sets the data of the next version: a frame (or the snapshot) 
+    //! received by the source shared data, without its snapshot header.
+    void setFrame(const Vector<byte>& data);
+
+protected:
+    virtual void getInstanceData( co::DataOStream& os );
+    virtual void applyInstanceData( co::DataIStream& is );
+    virtual void pack( co::DataOStream& os );
+    virtual void unpack( co::DataIStream& is );
+
+private:
+    SharedData* mySource;
+    // The frame is read on the Collage command thread by snapshots.
+    omicron::Lock myLock;
+    Vector<byte> myFrame;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! @internal
+//! An append-only, memory-mapped recording of the shared data stream: one 
+//! record per committed version (update context and object payloads, in 
+//! the format of SharedData::pack) and a frame index written on close. 
+//! Input captures use the same file, with one record of events per frame. The
+//! header keeps the end of the last complete record, so the recording of a
+//! crashed master can be replayed up to its last frame: the index is then
+//! rebuilt by scanning the records.
+class SharedDataRecording
+{
+public:
+    //! Shared data versions, or captured input events. Each type has its own
+    //! file magic, so one cannot be replayed as the other.
+    enum Type { SharedDataStream, InputCapture };
+
+public:
+    SharedDataRecording();
+    ~SharedDataRecording();
+
+    //! Creates a new recording. An existing file is overwritten. elementSize
+    //! is the size of the fixed-size elements records are made of, if any.
+    bool create(const String& path, Type type = SharedDataStream, uint32_t elementSize = 0);
+    //! Opens a recording for replay. Fails if the recording type or element
+    //! size do not match.
+    bool open(const String& path, Type type = SharedDataStream, uint32_t elementSize = 0);
+    //! Writes the frame index (recordings only) and unmaps the file.
+    void close();
+    bool isOpen() { return myData != NULL; }
+
+    void append(uint32_t frameNum, const Vector<byte>& data);
+
+    int getNumFrames() { return myIndex.size(); }
+    //! Returns the payload of a recorded frame.
+    const byte* getFrame(int index, uint32_t* frameNum, uint64_t* size);
+
+private:
+    bool mapFile(uint64_t size, bool write);
+    void unmapFile();
+    void reserve(uint64_t size);
+    bool readIndex();
+
+private:
+    String myPath;
+    bool myWriting;
+    byte* myData;
+    uint64_t myMappedSize;
+    // End of the last complete record.
+    uint64_t myEnd;
+    Vector<uint64_t> myIndex;
+    // File descriptor (HANDLE on Windows) and mapping handle (Windows).
+    intptr_t myFile;
+    void* myMapping;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
 class EqualizerSharedOStream: public SharedOStream
 {
 public:
-    EqualizerSharedOStream(co::DataOStream* stream) : myStream(stream) {}
+    EqualizerSharedOStream(co::DataOStream* stream) : myStream(stream), myBytes(0), myHash(NULL) {}
     SharedOStream& operator << (const String& str);
     void write(const void* data, uint64_t size);
+    uint64_t getBytesWritten() { return myBytes; }
+    //! When set, all bytes written are added to the hash.
+    void setHash(XXHash64* hash) { myHash = hash; }
 private:
     co::DataOStream* myStream;
+    uint64_t myBytes;
+    XXHash64* myHash;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
 class EqualizerSharedIStream: public SharedIStream
 {
 public:
-    EqualizerSharedIStream(co::DataIStream* stream) : myStream(stream) {}
+    EqualizerSharedIStream(co::DataIStream* stream) : 
+        myStream(stream), myData(NULL), mySize(0), myBytes(0), myTee(NULL), myHash(NULL) {}
+    //! Reads a version from memory (a recorded frame).
+    EqualizerSharedIStream(const byte* data, uint64_t size) : 
+        myStream(NULL), myData(data), mySize(size), myBytes(0), myTee(NULL), myHash(NULL) {}
     SharedIStream& operator >> (String& str);
     void read(void* data, uint64_t size);
+    uint64_t getBytesRead() { return myBytes; }
+    //! When set, all bytes read are also appended to the tee buffer.
+    void setTee(Vector<byte>* tee) { myTee = tee; }
+    //! When set, all bytes read are added to the hash.
+    void setHash(XXHash64* hash) { myHash = hash; }
+    //! Reads and discards the rest of the version.
+    void skipRemaining();
 private:
     co::DataIStream* myStream;
+    const byte* myData;
+    uint64_t mySize;
+    uint64_t myBytes;
+    Vector<byte>* myTee;
+    XXHash64* myHash;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! @internal
+//! The master frame clock. Time is measured with a 64-bit monotonic clock, 
+//! so it does not lose precision over long uptimes. The time step can be 
+//! filtered (exponential moving average or median of the last frames) to 
+//! reduce animation stutter, or fixed, to make animation independent of the
+//! actual frame rate.
+class FrameClock
+{
+public:
+    enum Filter { FilterNone, FilterEma, FilterMedian };
+    static const int MedianWindow = 5;
+
+    //! Returns the current value of the monotonic clock, in microseconds.
+    static uint64_t now();
+
+public:
+    FrameClock();
+    void setup(Setting& s);
+    void reset();
+    //! Advances the clock to the current frame.
+    void tick();
+
+    //! Sum of the time steps since reset, in seconds (frame count * time 
+    //! step in fixed mode). Differs from the actual time since reset when 
+    //! time steps are filtered or clamped.
+    double getTime() { return myTime; }
+    //! getTime in microseconds.
+    uint64_t getTimeUs() { return (uint64_t)(myTime * 1000000.0 + 0.5); }
+    //! Filtered (or fixed) time step, in seconds.
+    double getDt() { return myDt; }
+    //! Actual time since the previous frame, in seconds.
+    double getRawDt() { return myRawDt; }
+    void setFixedTimestep(float dt) { myFixedTimestep = dt; }
+    float getFixedTimestep() { return myFixedTimestep; }
+
+private:
+    // Configuration
+    Filter myFilter;
+    float mySmoothing;
+    float myFixedTimestep;
+
+    uint64_t myStartTime;
+    uint64_t myLastTime;
+    uint64_t myFrames;
+    double myTime;
+    double myDt;
+    double myRawDt;
+    List<double> myHistory;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! @internal
+//! Latency distribution in fixed-width millisecond buckets, with the last 
+//! bucket collecting all samples above the range. Samples are also added to
+//! a stat, and the histogram is periodically logged if a report interval is
+//! set. Samples can be added from multiple pipe threads.
+class LatencyHistogram
+{
+public:
+    static const int NumBuckets = 12;
+
+public:
+    LatencyHistogram(const String& name);
+    //! Reads the bucket width (ms) and report interval (samples) options.
+    void setup(Setting& s);
+    void addSample(uint64_t latencyUs);
+    //! Moving average of the latency, in microseconds. Not reset by reports.
+    double getAverage();
+    String toString();
+
+private:
+    void report();
+
+private:
+    omicron::Lock myLock;
+    String myName;
+    float myBucketWidth;
+    int myReportInterval;
+    uint64_t myBuckets[NumBuckets];
+    uint64_t mySamples;
+    uint64_t myTotal;
+    uint64_t myMax;
+    double myAverage;
+    Ref<Stat> myStat;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! @internal
+//! Draw, swap barrier and swap times of the windows of this node 
+//! (frameTimingStats). Each window reports its own times, exposed as 
+//! per-tile stats, and the node stats aggregate all windows of a frame: the
+//! slowest draw and swap, and the shortest barrier wait, since the window 
+//! that waits least is the one the barrier waited for. Barrier wait is the 
+//! time from the end of the last channel draw to the swap, so it also
+//! includes the GPU finishing the frame. Windows report from their pipe 
+//! threads.
+class FrameTimings
+{
+public:
+    FrameTimings();
+    void setup(Setting& s);
+    bool isEnabled() { return myEnabled; }
+    //! Times in microseconds. Called from the pipe threads.
+    void addWindowFrame(const String& window, uint32_t frameNumber, uint64_t draw, uint64_t wait, uint64_t swap);
+
+private:
+    struct WindowStats
+    {
+        Ref<Stat> draw;
+        Ref<Stat> wait;
+        Ref<Stat> swap;
+    };
+
+    void flush();
+
+private:
+    bool myEnabled;
+    omicron::Lock myLock;
+    uint32_t myFrame;
+    int myWindows;
+    uint64_t myDraw;
+    uint64_t myWait;
+    uint64_t mySwap;
+    Ref<Stat> myDrawStat;
+    Ref<Stat> myWaitStat;
+    Ref<Stat> mySwapStat;
+    Dictionary<String, WindowStats> myWindowStats;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! @internal
+//! Background log writer used by EqualizerLogStreamBuf. Writers assemble 
+//! lines in a per-thread buffer and queue complete lines. The sink thread 
+//! sends them to the omega log, suppressing repeated messages above the 
+//! rate limit.
+class LogSink: public co::base::Thread
+{
+public:
+    LogSink();
+    //! Stops the sink thread after logging all pending messages.
+    virtual ~LogSink();
+    //! Can be called from any thread.
+    void write(const char* data, size_t size);
+    void setRateLimit(int maxRepeats, int intervalMs);
+    virtual void run();
+
+private:
+    struct Record
+    {
+        int thread;
+        String text;
+    };
+    struct RepeatInfo
+    {
+        uint64_t windowStart;
+        int count;
+        int suppressed;
+    };
+
+    void process(Record* r);
+    void expireRepeats(bool all);
+
+private:
+    //! NULL stops the sink thread.
+    co::base::MTQueue<Record*> myQueue;
+    volatile int myMaxRepeats;
+    volatile int myRateInterval;
+    Dictionary<String, RepeatInfo> myRepeats;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! @internal
+//! Shuts down the application instance on a remote node and confirms it 
+//! exited. The kill command is launched first, then the node is polled until its
+//! Equalizer port stops accepting connections and the (optional) check 
+//! command stops succeeding. If this does not happen within the timeout, the
+//! escalation command is run and the node is polled again. Each node is 
+//! handled by its own thread, so a cluster is killed concurrently.
+class NodeKiller: public co::base::Thread
+{
+public:
+    struct Options
+    {
+        //! Commands. %c is replaced by the process name, %h by the hostname.
+        String killCommand;
+        String checkCommand;
+        String escalationCommand;
+        //! Seconds to wait for confirmation after each kill step.
+        float timeout;
+    };
+
+public:
+    NodeKiller(const Options& opts, const String& procName, const String& hostname, int port);
+    virtual void run();
+    //! Stops waiting for confirmation. The thread exits after the current 
+    //! check completes.
+    void stop() { myStopRequested = true; }
+    bool isDone() { return myDone; }
+    bool isConfirmed() { return myConfirmed; }
+    const String& getHostname() { return myHostname; }
+
+private:
+    String expand(const String& command);
+    bool isAlive();
+    bool isPortOpen();
+    bool waitForExit();
+
+private:
+    Options myOptions;
+    String myProcName;
+    String myHostname;
+    int myPort;
+    volatile bool myDone;
+    volatile bool myConfirmed;
+    volatile bool myStopRequested;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! @internal
+//! Compact record of an input event received by an Equalizer window. Records
+//! are queued by ConfigImpl::handleEvent and only expanded into full omegalib
+//! events once per frame, right before dispatch.
+struct InputRecord
+{
+    enum Kind { KeyboardButton, PointerMotion, PointerButton, PointerWheel };
+    uint8_t kind;
+    //! Event type for keys, pressed state for pointer buttons
+    uint8_t type;
+    //! Key code or pointer button flags
+    uint32_t code;
+    int32_t x;
+    int32_t y;
+    int32_t wheel;
+    //! Ingestion time (FrameClock::now)
+    uint64_t time;
+    //! Number of events in the service manager queue when the record was 
+    //! queued: the record is expanded before the events that follow it.
+    int32_t eventIndex;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! @internal
+//! A preallocated ring of input records. When motion coalescing is enabled 
+//! (coalescePointerMotion, off by default) consecutive pointer motion 
+//! records with no service event between them are merged into the most 
+//! recent one (keeping the ingestion time of the oldest), so bursts of mouse
+//! motion do not generate one event per sample. When the ring is full new
+//! records are dropped and counted in a stat.
+class InputQueue
+{
+public:
+    InputQueue();
+    void setup(Setting& s);
+    void setCoalesceMotion(bool enabled) { myCoalesceMotion = enabled; }
+    void push(const InputRecord& r);
+    bool pop(InputRecord& r);
+    bool isEmpty() { return myCount == 0; }
+
+private:
+    omicron::Lock myLock;
+    Vector<InputRecord> myRecords;
+    int myHead;
+    int myCount;
+    bool myCoalesceMotion;
+    Ref<Stat> myDroppedStat;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! @internal
+//! Extrapolates the pose of tracked objects (mocap and wand trackers, 
+//! pointers) to the time the current frame is expected to be displayed, 
+//! using a constant-velocity model over the event timestamps.
+//! Each service type / source id pair is tracked separately. The error 
+//! between past predictions and the poses actually observed at their target
+//! time is exposed as a stat.
+class PosePredictor
+{
+public:
+    PosePredictor();
+    ~PosePredictor();
+    void setup(Setting& s);
+    bool isEnabled() { return myEnabled; }
+    //! Sets the measured input-to-display latency, used as the prediction 
+    //! horizon unless a fixed horizon is configured.
+    void setMeasuredLatency(double latencyUs) { myMeasuredLatency = latencyUs; }
+    //! Predicts the pose in evt. Velocities are estimated from the event 
+    //! timestamps, or from dispatchTimeUs for events without one. elapsedUs
+    //! is how much of the measured latency has already passed at dispatch.
+    void process(Event* evt, uint64_t dispatchTimeUs, uint64_t elapsedUs);
+
+private:
+    struct Prediction
+    {
+        uint64_t time;
+        Vector3f position;
+    };
+    struct Track
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        uint64_t time;
+        Vector3f position;
+        Vector3f velocity;
+        Quaternion orientation;
+        Vector3f angularVelocity;
+        List<Prediction> predictions;
+    };
+
+    Track* getTrack(Event* evt);
+    void updateError(Track* t, uint64_t timeUs, const Vector3f& position);
+
+private:
+    bool myEnabled;
+    float myFixedHorizon;
+    float myMaxHorizon;
+    float mySmoothing;
+    double myMeasuredLatency;
+    Dictionary<uint64_t, Track*> myTracks;
+    Ref<Stat> myErrorStat;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -129,24 +1021,162 @@ public:
     virtual bool init();
     virtual bool exit();
     void mapSharedData(const uint128_t& initID);
+    void unmapSharedData();
     void updateSharedData();
+    //! Waits for deferred shared object updates to complete.
+    void finishSharedDataApply() { mySharedData.finishApply(); }
     virtual bool handleEvent(const eq::ConfigEvent* event);
     virtual uint32_t startFrame( const uint128_t& version );
     const UpdateContext& getUpdateContext();
+    //! Frame time in microseconds, as measured by the master frame clock.
+    uint64_t getFrameTime() { return mySharedData.getFrameTime(); }
+
+    //! Processes pending Equalizer events and polls services outside of a
+    //! frame. Returns true if there are input events waiting to be handled.
+    bool pollEvents();
+    SharedData* getSharedData() { return &mySharedData; }
+    bool isBulkLaneEnabled() { return mySharedData.getBulkLane() != NULL; }
+
+    //! Input-to-draw and input-to-display latency on this node.
+    LatencyHistogram* getDrawLatency() { return &myDrawLatency; }
+    LatencyHistogram* getDisplayLatency() { return &myDisplayLatency; }
+    FrameTimings* getFrameTimings() { return &myFrameTimings; }
+
+    //! True when the frames come from a shared data recording 
+    //! (sharedDataReplay) or an input capture (inputReplay) instead of the
+    //! input services. Replayed frames are not paced. Replay runs on the 
+    //! master: the shared data is applied as on a slave, but the engine and
+    //! modules still take their master code paths.
+    bool isReplaying() { return myReplay != NULL || myInputReplay != NULL; }
+
+    //! Divergence detection (divergenceCheck): called on every node after 
+    //! Engine::update. Slaves send the hashes of the shared data version 
+    //! they applied, and of the state of the objects listed in 
+    //! divergenceObjects, to the master, which compares them with its own.
+    void checkFrameState();
 
 private:
     void processMousePosition(eq::Window* source, int x, int y, Vector2i& outPosition, Ray& ray);
     uint processMouseButtons(uint btns); 
+    void queueInput(InputRecord::Kind kind, int type, uint code, int x = 0, int y = 0, int wheel = 0);
+    //! Expands the queued input records into the service manager queue, 
+    //! in arrival order with the service events. Returns the ingestion time
+    //! of the first record. Called with the event queue locked.
+    uint64_t expandInputRecords(ServiceManager* sm);
+    void updateLaneStats(double syncTime);
+    void createNodeLanes(Setting& s);
+    bool mapRelayParent(const String& parentKey);
+    void setupRecording(Setting& s);
+    uint32_t replayFrame(const uint128_t& version);
+    void replayInput(ServiceManager* sm);
+    //! Config event type of frame hash reports.
+    enum { FrameHashEvent = eq::Event::USER + 1 };
+    struct FrameHashReport
+    {
+        uint32_t frameNum;
+        // Node port (basePort + node port), 0 for the master. Only used in
+        // messages: ports are not unique across hosts.
+        uint32_t port;
+        // Hash of the node key (hostname:port), 0 for the master.
+        uint64_t nodeHash;
+        uint64_t streamHash;
+        uint64_t stateHash;
+    };
+    void checkFrameHashReport(const FrameHashReport& r);
+    //! Node key of a report, or its port if the node is unknown.
+    String getReportNode(const FrameHashReport& r);
 
 private:
     SharedData mySharedData;
-    Timer myGlobalTimer;
+    //! Bulk lane, attached to mySharedData when sharedDataBulkLane is enabled.
+    SharedData myBulkSharedData;
+    Ref<Stat> myPriorityBytesStat;
+    Ref<Stat> myBulkBytesStat;
+    Ref<Stat> myPrioritySyncStat;
+    Ref<Stat> myBulkLagStat;
+    uint64_t myLastBulkFrameTime;
+    //! Interest filtering node lanes: one per remote node on the master, 
+    //! the local one on slaves.
+    List<SharedData*> myNodeLanes;
+    String myLocalNodeKey;
+    Ref<Stat> myNodeLaneBytesStat;
+    //! Relay tree: set when other nodes receive the shared data through 
+    //! this node.
+    SharedDataRelay* myRelay;
+    //! Recording (master) and replay of the shared data stream.
+    SharedDataRecording* myRecording;
+    SharedDataRecording* myReplay;
+    int myReplayFrame;
+    Timer myReplayTimer;
+    double myReplayApplyTime;
+    Ref<Stat> myReplayApplyStat;
+    //! Capture and replay of the input dispatched by the master.
+    SharedDataRecording* myInputCapture;
+    SharedDataRecording* myInputReplay;
+    Vector<byte> myInputCaptureBuffer;
+    int myInputReplayFrame;
+    //! Divergence detection. The master keeps its hashes for the last 
+    //! FrameHashHistory frames, and tracks which nodes diverged.
+    static const int FrameHashHistory = 256;
+    bool myDivergenceCheck;
+    Vector<String> myDivergenceObjects;
+    FrameHashReport myFrameHashes[FrameHashHistory];
+    Dictionary<uint64_t, bool> myDivergentNodes;
+    //! Node key hash -> node key, for divergence messages.
+    Dictionary<uint64_t, String> myReportNodes;
+    Ref<Stat> myDivergenceStat;
+    FrameClock myFrameClock;
     //! Global fps counter.
     Ref<Stat> myFpsStat;
+    LatencyHistogram myDrawLatency;
+    LatencyHistogram myDisplayLatency;
+    FrameTimings myFrameTimings;
+    PosePredictor myPosePredictor;
+    InputQueue myInputQueue;
+    Vector<int> myInputRecordIndices;
+    Vector<byte> myInputEventBuffer;
 
     omicron::Ref<Engine> myServer;
 };
 
+///////////////////////////////////////////////////////////////////////////////
+//! @internal
+//! Pins the node main thread (running Engine::update) and the pipe threads 
+//! to CPU sets. In manual mode, nodeThreadCpus and pipeThreadCpus (one 
+//! entry per device) list the CPUs as in "0-7,16-23". In auto mode, each 
+//! pipe thread runs on the CPUs of the NUMA node its GPU is attached to, and
+//! the node thread on the NUMA node of the first pipe. Entries given in 
+//! auto mode override the automatic choice.
+class ThreadAffinity
+{
+public:
+    enum Mode { Auto, Manual };
+
+public:
+    ThreadAffinity();
+
+    void setup(Setting& s);
+    //! Must be called from the node main thread.
+    void pinNodeThread(int device);
+    //! Must be called from the pipe thread.
+    void pinPipeThread(const String& pipeName, int device);
+
+private:
+    //! Returns the CPUs for the given device, or an empty list to leave the
+    //! thread unpinned. numaNode is set to -1 when unknown.
+    Vector<int> getDeviceCpus(int device, int& numaNode);
+    int getDeviceNumaNode(int device);
+    void pin(const String& threadName, const Vector<int>& cpus, int numaNode);
+    static Vector<int> parseCpuList(const String& list);
+    static String toCpuList(const Vector<int>& cpus);
+
+private:
+    Mode myMode;
+    String myNodeCpus;
+    Vector<String> myPipeCpus;
+    Vector<String> myDevicePciAddresses;
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 //! @internal
 class NodeImpl: public eq::Node
@@ -168,6 +1198,19 @@ private:
     //FrameData myFrameData;
 };
 
+///////////////////////////////////////////////////////////////////////////////
+//! @internal
+//! A Pipe manages one graphics device. All windows of a pipe are driven by 
+//! the pipe thread.
+class PipeImpl: public eq::Pipe
+{
+public:
+    PipeImpl(eq::Node* parent);
+
+protected:
+    virtual bool configInit( const eq::uint128_t& initID );
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 //! @internal
 //! A Window represents an on-screen or off-screen drawable. A drawable is a 2D rendering surface, 
@@ -185,11 +1228,17 @@ public:
 
     DisplayTileConfig* getTileConfig() { return myTile; }
     Renderer* getRenderer();
+    //! Latency from the input handled in the current frame to now, in 
+    //! microseconds, or SharedData::NoInput.
+    uint64_t getInputLatency();
+    //! Called by the channel after it draws a frame. Times in microseconds.
+    void channelDrawn(uint64_t start, uint64_t end);
 
 protected:
     virtual bool configInit(const uint128_t& initID);
     virtual bool configExit();
     virtual void frameStart(const uint128_t& frameID, const uint32_t frameNumber);
+    virtual void swapBuffers();
     bool processEvent(const eq::Event& event);
 
 private:
@@ -201,6 +1250,15 @@ private:
     // set to true to skip next resize event (when resize is happening not because of
     // user interaction)s
     bool mySkipResize; 
+
+    // Input age and local arrival time of the frame being drawn.
+    uint64_t myInputAge;
+    uint64_t myInputFrameTime;
+
+    // Frame timings (see FrameTimings)
+    uint32_t myFrameNumber;
+    uint64_t myDrawTime;
+    uint64_t myDrawEnd;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -219,16 +1277,140 @@ public:
 
 protected:
     virtual bool configInit(const uint128_t& initID);
+    virtual bool configExit();
     virtual void frameDraw( const uint128_t& spin );
 
     omega::Renderer* getRenderer();
 
+private:
+    void initializeReadback();
+    void disposeReadback();
+    void readbackFrame(uint64 frameNum);
+
 private:
     WindowImpl* myWindow;
     omicron::Lock myLock;
     DrawContext myDC;
     uint128_t myLastFrame;
-    omicron::Ref<RenderTarget> myDrawBuffer;
+
+    // Asynchronous frame readback (see FrameExporter). Each slot owns a pixel
+    // pack buffer. A readback is queued into the current slot every frame and
+    // the oldest slot is mapped and handed to the exporter, so we never wait
+    // for the transfer of the frame we just drew.
+    struct ReadbackSlot
+    {
+        uint pbo;
+        uint64 frameNum;
+        int width;
+        int height;
+        bool pending;
+    };
+    Vector<ReadbackSlot> myReadbackSlots;
+    int myCurrentReadbackSlot;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! @internal
+//! Controls the frame rate of the master loop. Frames can be capped to a 
+//! maximum rate, and idle frames (no input, no shared data changes) can be 
+//! skipped, running only one frame every idleFrameInterval seconds. In 
+//! on-demand redraw mode, idle frames are never run: the cluster only draws
+//! when there is input, shared data changed or a redraw was requested.
+//! Frame interval and jitter are exposed as stats.
+class FramePacer
+{
+public:
+    enum RedrawMode { RedrawContinuous, RedrawOnDemand };
+
+public:
+    FramePacer();
+
+    void setup(Setting& s);
+    bool isIdleFrameSkipEnabled() { return myIdleFrameSkip || myRedrawMode == RedrawOnDemand; }
+    RedrawMode getRedrawMode() { return myRedrawMode; }
+
+    //! Forces the next frame to run, even if nothing changed. Can be called
+    //! from any thread.
+    void requestRedraw();
+
+    //! Waits until the next frame is due. Returns false if the frame should
+    //! be skipped because nothing changed.
+    bool waitForFrame(ConfigImpl* config);
+    //! Marks the start of a frame: updates interval and jitter stats.
+    void frameStarted();
+
+private:
+    // Configuration
+    float myMaxFps;
+    bool myIdleFrameSkip;
+    float myIdleFrameInterval;
+    RedrawMode myRedrawMode;
+    int myPollInterval;
+
+    // Set by requestRedraw, tested and cleared by waitForFrame under the lock
+    // so requests made while a frame is being decided are not lost.
+    omicron::Lock myRedrawLock;
+    bool myRedrawRequested;
+
+    Timer myTimer;
+    double myLastFrameStart;
+    double myLastInterval;
+    Ref<Stat> myIntervalStat;
+    Ref<Stat> myJitterStat;
+    Ref<Stat> mySkippedFramesStat;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! @internal
+//! A frame read back from a channel, waiting to be handed to the frame export
+//! listeners. Pixels are RGBA, 8 bits per component, bottom row first.
+struct ExportedFrame
+{
+    String channelName;
+    uint64 frameNum;
+    int width;
+    int height;
+    Vector<byte> pixels;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! @internal
+//! Hands frames read back by ChannelImpl to the registered
+//! FrameExportListeners on a worker thread. Pipe threads never block here: 
+//! if the listeners fall behind and the queue is full, frames are dropped.
+class FrameExporter: public co::base::Thread
+{
+public:
+    FrameExporter(int maxQueuedFrames);
+    virtual ~FrameExporter();
+
+    void addListener(FrameExportListener* listener);
+    void removeListener(FrameExportListener* listener);
+    bool hasListeners() { return myNumListeners > 0; }
+
+    //! Returns an unused frame, or NULL if the export queue is full.
+    ExportedFrame* acquireFrame();
+    //! Queues a frame returned by acquireFrame for export.
+    void submitFrame(ExportedFrame* frame);
+    //! Returns a frame to the pool without exporting it.
+    void releaseFrame(ExportedFrame* frame);
+
+    //! Exports the frames already queued, then stops the export thread.
+    void shutdown();
+
+    virtual void run();
+
+private:
+    omicron::Lock myFreeLock;
+    omicron::Lock myListenerLock;
+    //! Frames waiting for export. A NULL frame tells the thread to exit.
+    co::base::MTQueue<ExportedFrame*> myQueue;
+    List<ExportedFrame*> myFreeFrames;
+    List< Ref<FrameExportListener> > myListeners;
+    int myNumListeners;
+    int myMaxQueuedFrames;
+    int myAllocatedFrames;
+    Ref<Stat> myDroppedFramesStat;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -244,6 +1426,8 @@ public:
         { return new ChannelImpl( parent ); }
     virtual eq::Window* createWindow(eq::Pipe* parent)
         { return new WindowImpl(parent); }
+    virtual eq::Pipe* createPipe(eq::Node* parent)
+        { return new PipeImpl(parent); }
     virtual eq::Node* createNode( eq::Config* parent )
        { return new NodeImpl( parent ); }
 };